@@ -161,6 +161,33 @@ void parse_tree_read_cmd1(char* source, TSNode cmd1, AVM_instr_t* ptr_instr, int
     instr.access = value;
     *ptr_instr = instr;
     SUCCESS(errno);
+  } else if (strcmp(ts_node_type(cmd1), "addi") == 0 ||
+             strcmp(ts_node_type(cmd1), "subi") == 0 ||
+             strcmp(ts_node_type(cmd1), "lei") == 0 ||
+             strcmp(ts_node_type(cmd1), "eqi") == 0) {
+    TSNode param = ts_node_child_by_field_name(cmd1, "value", 5);
+    char buffer[AVM_LITERAL_SIZE] = {};
+    parse_tree_read_text(source, param, buffer, AVM_LITERAL_SIZE, errno);
+    GUARD(errno);
+    AVM_instr_t instr = {};
+    int value = 0;
+    int count = sscanf(buffer, "%d", &value);
+    if (count != 1) {
+      REPORT(errno, cmd1, "Cannot use [%s] as an immediate (only support integers)",
+             buffer);
+    }
+    const char *type = ts_node_type(cmd1);
+    if (strcmp(type, "addi") == 0)
+      instr.kind = AVM_AddImm;
+    else if (strcmp(type, "subi") == 0)
+      instr.kind = AVM_SubImm;
+    else if (strcmp(type, "lei") == 0)
+      instr.kind = AVM_LeImm;
+    else
+      instr.kind = AVM_EqImm;
+    instr.const_int = value;
+    *ptr_instr = instr;
+    SUCCESS(errno);
   } else {
     AVM_instr_t instr = {};
     if (strcmp(ts_node_type(cmd1), "b") == 0) {
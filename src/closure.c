@@ -0,0 +1,377 @@
+#include "closure.h"
+#include "debug.h"
+#include "verify.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Closure conversion
+
+   A function body is the code reachable from a closure label without
+   entering another frame (see `frame_successors`); the top level is a
+   body as well. At each address of a body, the number of bindings the
+   body has made since its entry (2 for the argument and the closure,
+   then +1 per `let`, +2 per `grab`, -1 per `endlet`) must be the same
+   on every path. Then `acc i` reads a local binding when `i` is below
+   that number, and the `i - local`-th binding of the captured
+   environment otherwise.
+
+   The captured bindings a body may read are those of its own `acc`s,
+   plus those the closures it creates capture from it. When they are
+   known, `clos L` becomes
+
+     acc s(n-1); ...; acc s(0); FlatClosure L n
+
+   where s(0) < ... < s(n-1) are the captured indices, so that s(r)
+   lands at index r of the closure's environment, and each captured
+   `acc` of the body is renumbered to its rank. When n = 0, it becomes
+   `StaticClosure L` instead, which pushes the closure of L allocated
+   once by `init_vm`.
+
+   A body gives up (keeps capturing the whole environment) when its
+   local count is inconsistent, when it drops a captured binding with
+   `endlet`, when it shares code with another body, or when it creates
+   a closure that captures the whole environment. */
+
+typedef struct {
+  int entry;
+  _Bool flat;
+  _Bool *reads;  /* captured indices the body may read */
+  int *rank;     /* rank of each captured index among `reads` */
+  int size;      /* number of captured indices */
+} body_t;
+
+typedef struct {
+  AVM_code_t *code;
+  int width;       /* bound of the environment indices in the code */
+  body_t *bodies;
+  int body_count;
+  int *body_at;    /* body entered at a label, or -1 */
+  int *owner;      /* body of each address, or -1 if unreachable */
+  int *local;      /* bindings made by the owner at each address */
+} converter_t;
+
+static _Bool is_supported(AVM_instr_t *instr, int n) {
+  switch (instr->kind) {
+  case AVM_Jump:
+  case AVM_CJump:
+  case AVM_Closure:
+    return 0 <= instr->addr && instr->addr <= n;
+  case AVM_Access:
+    return instr->access >= 0;
+  case AVM_Ldi:
+  case AVM_Ldb:
+  case AVM_Let:
+  case AVM_EndLet:
+  case AVM_Add:
+  case AVM_Sub:
+  case AVM_Le:
+  case AVM_Eq:
+  case AVM_Apply:
+  case AVM_TailApply:
+  case AVM_PushMark:
+  case AVM_Grab:
+  case AVM_Return:
+  case AVM_Halt:
+  case AVM_AddImm:
+  case AVM_SubImm:
+  case AVM_LeImm:
+  case AVM_EqImm:
+    return true;
+  default:
+    /* Instructions produced by `optimize_code` come later. */
+    return false;
+  }
+}
+
+static int local_after(AVM_instr_t *instr, int local) {
+  switch (instr->kind) {
+  case AVM_Let:
+    return local + 1;
+  case AVM_Grab:
+    return local + 2;
+  case AVM_EndLet:
+    return local - 1;
+  default:
+    return local;
+  }
+}
+
+/* Assigns the addresses reachable from the entry of body `b` to it. */
+static void walk_body(converter_t *c, int b, int *stack) {
+  body_t *body = &c->bodies[b];
+  int n = c->code->instr_size;
+  int top = 0;
+
+  if (c->owner[body->entry] != -1) {
+    body->flat = false;
+    c->bodies[c->owner[body->entry]].flat = false;
+    return;
+  }
+  c->owner[body->entry] = b;
+  c->local[body->entry] = b == 0 ? 0 : 2;
+  stack[top++] = body->entry;
+
+  while (top > 0) {
+    int pc = stack[--top];
+    AVM_instr_t *instr = &c->code->instr[pc];
+    int local = local_after(instr, c->local[pc]);
+    if (local < 0) {
+      /* `endlet` drops a captured binding. */
+      body->flat = false;
+      local = 0;
+    }
+
+    int next[2];
+    int k = frame_successors(instr, pc, next);
+    for (int j = 0; j < k; ++j) {
+      int to = next[j];
+      if (to >= n)
+        continue;
+      if (c->owner[to] == -1) {
+        c->owner[to] = b;
+        c->local[to] = local;
+        stack[top++] = to;
+      } else if (c->owner[to] != b) {
+        body->flat = false;
+        c->bodies[c->owner[to]].flat = false;
+      } else if (c->local[to] != local) {
+        body->flat = false;
+      }
+    }
+  }
+}
+
+/* Records that body `b` reads environment index `i` at `pc`. Returns
+   false when `i` is captured but `b` has no known captured bindings:
+   the top level captures nothing, and other bodies that are not flat
+   may lack the binding. */
+static _Bool read_at(converter_t *c, int b, int pc, int i, _Bool *changed) {
+  body_t *body = &c->bodies[b];
+  int s = i - c->local[pc];
+  if (s < 0)
+    return true;
+  if (!body->flat)
+    return false;
+  if (!body->reads[s]) {
+    body->reads[s] = true;
+    *changed = true;
+  }
+  return true;
+}
+
+/* Computes the captured indices of every body, up to a fixpoint over
+   the closures bodies create. */
+static void collect_reads(converter_t *c) {
+  int n = c->code->instr_size;
+
+  for (int pc = 0; pc < n; ++pc) {
+    AVM_instr_t *instr = &c->code->instr[pc];
+    _Bool ignored;
+    if (c->owner[pc] > 0 && instr->kind == AVM_Access)
+      read_at(c, c->owner[pc], pc, instr->access, &ignored);
+  }
+
+  _Bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int pc = 0; pc < n; ++pc) {
+      AVM_instr_t *instr = &c->code->instr[pc];
+      if (instr->kind != AVM_Closure || instr->addr >= n)
+        continue;
+      body_t *callee = &c->bodies[c->body_at[instr->addr]];
+      int b = c->owner[pc];
+
+      if (b == -1) {
+        /* Unreachable; leave it as it is. */
+        if (callee->flat) {
+          callee->flat = false;
+          changed = true;
+        }
+        continue;
+      }
+
+      if (!callee->flat) {
+        /* The whole environment is captured, so the creator's too. */
+        if (b != 0 && c->bodies[b].flat) {
+          c->bodies[b].flat = false;
+          changed = true;
+        }
+        continue;
+      }
+
+      for (int s = 0; s < c->width && callee->flat; ++s) {
+        if (callee->reads[s] && !read_at(c, b, pc, s, &changed)) {
+          callee->flat = false;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  for (int b = 1; b < c->body_count; ++b) {
+    body_t *body = &c->bodies[b];
+    body->size = 0;
+    for (int s = 0; s < c->width; ++s)
+      body->rank[s] = body->reads[s] ? body->size++ : -1;
+    if (body->size > AVM_OP_INDEX_MAX)
+      body->flat = false;
+  }
+}
+
+/* The index of `acc i` at `pc` once the body of `pc` is flattened. */
+static int renumber(converter_t *c, int pc, int i) {
+  int b = c->owner[pc];
+  if (b <= 0 || !c->bodies[b].flat || i < c->local[pc])
+    return i;
+  return c->local[pc] + c->bodies[b].rank[i - c->local[pc]];
+}
+
+/* Whether `clos` at `pc` is replaced by a flat closure. */
+static body_t *flat_callee(converter_t *c, int pc) {
+  AVM_instr_t *instr = &c->code->instr[pc];
+  if (instr->kind != AVM_Closure || c->owner[pc] == -1 ||
+      instr->addr >= c->code->instr_size)
+    return NULL;
+  body_t *callee = &c->bodies[c->body_at[instr->addr]];
+  return callee->flat ? callee : NULL;
+}
+
+static AVM_code_t *copy_code(AVM_code_t *code) {
+  AVM_code_t *res = malloc(sizeof(AVM_code_t));
+  AVM_instr_t *instrs = malloc(sizeof(AVM_instr_t) * (code->instr_size > 0 ? code->instr_size : 1));
+  if (res == NULL || instrs == NULL)
+    error("flatten_closures: Couldn't allocate the code.");
+  memcpy(instrs, code->instr, sizeof(AVM_instr_t) * code->instr_size);
+  res->instr = instrs;
+  res->instr_size = code->instr_size;
+  return res;
+}
+
+static AVM_code_t *emit(converter_t *c) {
+  int n = c->code->instr_size;
+  int *map = malloc(sizeof(int) * (n + 1));
+  if (map == NULL)
+    error("flatten_closures: Couldn't allocate the address map.");
+
+  int size = 0;
+  for (int pc = 0; pc < n; ++pc) {
+    body_t *callee = flat_callee(c, pc);
+    size += callee != NULL ? callee->size + 1 : 1;
+  }
+
+  AVM_code_t *res = malloc(sizeof(AVM_code_t));
+  AVM_instr_t *instrs = malloc(sizeof(AVM_instr_t) * (size > 0 ? size : 1));
+  if (res == NULL || instrs == NULL)
+    error("flatten_closures: Couldn't allocate the code.");
+
+  int k = 0;
+  for (int pc = 0; pc < n; ++pc) {
+    AVM_instr_t *instr = &c->code->instr[pc];
+    body_t *callee = flat_callee(c, pc);
+    map[pc] = k;
+
+    if (callee == NULL) {
+      instrs[k] = *instr;
+      if (instr->kind == AVM_Access)
+        instrs[k].access = renumber(c, pc, instr->access);
+      ++k;
+      continue;
+    }
+
+    /* A closure capturing nothing is the same object every time. */
+    if (callee->size == 0) {
+      instrs[k++] = (AVM_instr_t){ .kind = AVM_StaticClosure, .addr = instr->addr };
+      continue;
+    }
+
+    /* Push the captured bindings, the last rank first. */
+    for (int s = c->width - 1; s >= 0; --s)
+      if (callee->reads[s])
+        instrs[k++] = ACCESS(renumber(c, pc, s));
+    instrs[k++] = (AVM_instr_t){ .kind = AVM_FlatClosure, .addr = instr->addr,
+                                 .const_int = callee->size };
+  }
+  map[n] = k;
+
+  for (int i = 0; i < k; ++i) {
+    switch (instrs[i].kind) {
+    case AVM_Jump:
+    case AVM_CJump:
+    case AVM_Closure:
+    case AVM_FlatClosure:
+    case AVM_StaticClosure:
+      instrs[i].addr = map[instrs[i].addr];
+      break;
+    default:
+      break;
+    }
+  }
+
+  free(map);
+  res->instr = instrs;
+  res->instr_size = k;
+  return res;
+}
+
+AVM_code_t *flatten_closures(AVM_code_t *code) {
+  int n = code->instr_size;
+  int width = 1;
+
+  for (int pc = 0; pc < n; ++pc) {
+    AVM_instr_t *instr = &code->instr[pc];
+    if (!is_supported(instr, n))
+      return copy_code(code);
+    if (instr->kind == AVM_Access && instr->access + 1 > width)
+      width = instr->access + 1;
+  }
+  if (n == 0)
+    return copy_code(code);
+
+  converter_t c = { .code = code, .width = width,
+                    .bodies = malloc(sizeof(body_t) * (n + 1)),
+                    .body_count = 0,
+                    .body_at = malloc(sizeof(int) * (n + 1)),
+                    .owner = malloc(sizeof(int) * (n + 1)),
+                    .local = calloc(n + 1, sizeof(int)) };
+  int *stack = malloc(sizeof(int) * (n + 1));
+  if (c.bodies == NULL || c.body_at == NULL || c.owner == NULL ||
+      c.local == NULL || stack == NULL)
+    error("flatten_closures: Couldn't allocate the analysis.");
+
+  for (int pc = 0; pc <= n; ++pc) {
+    c.body_at[pc] = -1;
+    c.owner[pc] = -1;
+  }
+
+  /* Body 0 is the top level, which is never flat; a closure of its
+     code is body 0 too. */
+  c.body_at[0] = c.body_count;
+  c.bodies[c.body_count++] = (body_t){ .entry = 0, .flat = false };
+  for (int pc = 0; pc < n; ++pc) {
+    int l = code->instr[pc].addr;
+    if (code->instr[pc].kind == AVM_Closure && l < n && c.body_at[l] == -1) {
+      c.body_at[l] = c.body_count;
+      c.bodies[c.body_count++] = (body_t){ .entry = l, .flat = true,
+                                           .reads = calloc(width, sizeof(_Bool)),
+                                           .rank = malloc(sizeof(int) * width) };
+      if (c.bodies[c.body_count - 1].reads == NULL || c.bodies[c.body_count - 1].rank == NULL)
+        error("flatten_closures: Couldn't allocate the analysis.");
+    }
+  }
+  for (int b = 0; b < c.body_count; ++b)
+    walk_body(&c, b, stack);
+  collect_reads(&c);
+
+  AVM_code_t *res = emit(&c);
+
+  for (int b = 1; b < c.body_count; ++b) {
+    free(c.bodies[b].reads);
+    free(c.bodies[b].rank);
+  }
+  free(c.bodies);
+  free(c.body_at);
+  free(c.owner);
+  free(c.local);
+  free(stack);
+  return res;
+}
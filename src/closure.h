@@ -0,0 +1,11 @@
+#pragma once
+
+#include "code.h"
+
+/* Returns a copy of `code` where every `clos L` whose body can be
+   analysed captures only the bindings the body may read. The captured
+   values are pushed by `acc`s and packed by `AVM_FlatClosure L n`, and
+   the `acc`s of the body are renumbered accordingly. Both the result
+   and its `instr` are allocated from heap; addresses are retargeted
+   as in `optimize_code`. */
+AVM_code_t *flatten_closures(AVM_code_t *code);
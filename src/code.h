@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum {
   AVM_Ldi     , AVM_Ldb       , AVM_Access   ,
@@ -8,7 +9,27 @@ typedef enum {
   AVM_Jump    , AVM_CJump     , AVM_Add      ,
   AVM_Sub     , AVM_Le        , AVM_Eq       ,
   AVM_Apply   , AVM_TailApply , AVM_PushMark ,
-  AVM_Grab    , AVM_Return    , AVM_Halt
+  AVM_Grab    , AVM_Return    , AVM_Halt     ,
+  AVM_AddImm  , AVM_SubImm    , AVM_LeImm    ,
+  AVM_EqImm   ,
+  /* Superinstructions; only produced by `optimize_code`. */
+  AVM_AccAccLeBf , AVM_AccSubImm , AVM_MarkAcc ,
+  AVM_AccApply   , AVM_AccTailApply ,
+  AVM_BranchIfGt , AVM_BranchIfNe ,
+  AVM_BranchIfGtImm , AVM_BranchIfNeImm ,
+  /* Only produced by `flatten_closures`. */
+  AVM_FlatClosure , AVM_StaticClosure ,
+  /* Only produced by `optimize_code`, with the number of arguments in
+     `const_int`. */
+  AVM_ApplyN    , AVM_TailApplyN ,
+  AVM_AccApplyN , AVM_AccTailApplyN ,
+  /* Applications of the static closure of `addr`, with the number of
+     arguments in `const_int`; produced by `optimize_code` and `init_vm`. */
+  AVM_CallDirect , AVM_TailCallDirect ,
+  /* Only produced by `init_vm`: a `TailCallDirect` of the running
+     closure, which binds its `const_int` arguments in place and jumps
+     to `addr`, past the grabs that would bind them. */
+  AVM_SelfTailCall
 } AVM_instr_kind;
 
 struct AVM_instr;
@@ -16,10 +37,13 @@ struct AVM_code;
 
 typedef struct AVM_instr {
   AVM_instr_kind   kind;
-  int              const_int;
+  int              const_int; // also the immediate of AddImm, SubImm, ...
   _Bool            const_bool;
   int              access;
-  int              addr; // for Closure and Jumps
+  int              access2; // for AccAccLeBf
+  int              addr; // for Closure, CallDirect and Jumps (incl. BranchIf*)
+                         // FlatClosure keeps its size in const_int
+                         // StaticClosure captures nothing
   void*            payload;
 } AVM_instr_t;
 
@@ -28,6 +52,52 @@ typedef struct AVM_code {
   int          instr_size;
 } AVM_code_t;
 
+/* Threaded form of an instruction executed by `run()`. `handler` is
+   the address of the opcode's handler inside `run()`, resolved by
+   `thread_code` before the first dispatch. The operand holds whichever
+   of `const_int`, `const_bool`, `access` or `addr` the kind uses, and
+   that of `grab` the number of `grab`s right before it;
+   superinstructions with two environment indices keep them in
+   `index`, as `AccApplyN` and `CallDirect` keep their number of
+   arguments, and branches on an immediate keep it in `imm`. Label
+   payloads never reach this form. */
+typedef struct AVM_op {
+  const void *handler;
+  int32_t     operand;
+  uint8_t     kind;
+  uint8_t     flags;
+  union {
+    uint8_t   index[2];
+    int16_t   imm;
+  };
+} AVM_op_t;
+
+/* `flags`: the verifier proved every runtime check of the instruction
+   redundant, so it is threaded to its unchecked handler. */
+#define AVM_OP_UNCHECKED 1
+/* The closure made by a `Closure` or a `FlatClosure` never outlives its
+   frame, so it is allocated in the frame's region. */
+#define AVM_OP_REGION    2
+
+#define AVM_OP_INDEX_MAX UINT8_MAX
+#define AVM_OP_IMM_MIN   INT16_MIN
+#define AVM_OP_IMM_MAX   INT16_MAX
+
+_Static_assert(sizeof(AVM_op_t) == 16, "AVM_op_t must stay two words.");
+
+/* Space used by a frame, i.e. by a function body from its entry to
+   its return, not counting the functions it calls: the values it
+   pushes to the argument stack and binds in the environment cache
+   (the closure and its argument included). */
+typedef struct {
+  int stack;
+  int env;
+  /* Arguments a closure entered here binds before running anything but
+     a `grab`: one, plus its leading `grab`s. Set by `init_vm`; it is
+     kept with the space since calls read both. */
+  int arity;
+} AVM_frame_size_t;
+
 #define HALT()      ((AVM_instr_t){ .kind = AVM_Halt })
 #define LDI(n)      ((AVM_instr_t){ .kind = AVM_Ldi,     .const_int  = (n) })
 #define LDB(b)      ((AVM_instr_t){ .kind = AVM_Ldb,     .const_bool = (b) })
@@ -38,6 +108,11 @@ typedef struct AVM_code {
 #define LE()        ((AVM_instr_t){ .kind = AVM_Le })
 #define EQ()        ((AVM_instr_t){ .kind = AVM_Eq })
 
+#define ADDI(n)     ((AVM_instr_t){ .kind = AVM_AddImm, .const_int = (n) })
+#define SUBI(n)     ((AVM_instr_t){ .kind = AVM_SubImm, .const_int = (n) })
+#define LEI(n)      ((AVM_instr_t){ .kind = AVM_LeImm,  .const_int = (n) })
+#define EQI(n)      ((AVM_instr_t){ .kind = AVM_EqImm,  .const_int = (n) })
+
 #define LET()       ((AVM_instr_t){ .kind = AVM_Let })
 #define ENDLET()    ((AVM_instr_t){ .kind = AVM_EndLet })
 
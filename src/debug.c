@@ -71,6 +71,96 @@ void disassemble_instruction(AVM_code_t *code, int pc) {
   case AVM_Halt:
     printf("halt");
     break;
+  case AVM_AddImm:
+    printf("addi %d", instr->const_int);
+    break;
+  case AVM_SubImm:
+    printf("subi %d", instr->const_int);
+    break;
+  case AVM_LeImm:
+    printf("lei  %d", instr->const_int);
+    break;
+  case AVM_EqImm:
+    printf("eqi  %d", instr->const_int);
+    break;
+  case AVM_AccAccLeBf:
+    printf("acc.acc.le.bf %d, %d, %d", instr->access, instr->access2, instr->addr);
+    break;
+  case AVM_AccSubImm:
+    printf("acc.subi %d, %d", instr->access, instr->const_int);
+    break;
+  case AVM_MarkAcc:
+    printf("mark.acc %d", instr->access);
+    break;
+  case AVM_AccApply:
+    printf("acc.app %d", instr->access);
+    break;
+  case AVM_AccTailApply:
+    printf("acc.tapp %d", instr->access);
+    break;
+  case AVM_BranchIfGt:
+    printf("bgt  %d", instr->addr);
+    break;
+  case AVM_BranchIfNe:
+    printf("bne  %d", instr->addr);
+    break;
+  case AVM_BranchIfGtImm:
+    printf("bgti %d, %d", instr->const_int, instr->addr);
+    break;
+  case AVM_BranchIfNeImm:
+    printf("bnei %d, %d", instr->const_int, instr->addr);
+    break;
+  case AVM_FlatClosure:
+    printf("clos.flat %d, %d", instr->addr, instr->const_int);
+    break;
+  case AVM_StaticClosure:
+    printf("clos.static %d", instr->addr);
+    break;
+  case AVM_ApplyN:
+    printf("app.n %d", instr->const_int);
+    break;
+  case AVM_TailApplyN:
+    printf("tapp.n %d", instr->const_int);
+    break;
+  case AVM_AccApplyN:
+    printf("acc.app.n %d, %d", instr->access, instr->const_int);
+    break;
+  case AVM_AccTailApplyN:
+    printf("acc.tapp.n %d, %d", instr->access, instr->const_int);
+    break;
+  case AVM_CallDirect:
+    printf("call %d, %d", instr->addr, instr->const_int);
+    break;
+  case AVM_TailCallDirect:
+    printf("tcall %d, %d", instr->addr, instr->const_int);
+    break;
+  case AVM_SelfTailCall:
+    printf("tcall.self %d, %d", instr->addr, instr->const_int);
+    break;
   }
   printf("\n");
 }
+
+void disassemble_code(AVM_code_t *code, AVM_frame_size_t *frames) {
+  _Bool *entries = calloc(code->instr_size + 1, sizeof(_Bool));
+  if (entries == NULL)
+    error("disassemble_code: Couldn't allocate %d flags.", code->instr_size + 1);
+
+  entries[0] = true;
+  for (int pc = 0; pc < code->instr_size; ++pc) {
+    AVM_instr_t *instr = &code->instr[pc];
+    if ((instr->kind == AVM_Closure || instr->kind == AVM_FlatClosure ||
+         instr->kind == AVM_StaticClosure || instr->kind == AVM_CallDirect ||
+         instr->kind == AVM_TailCallDirect) && 0 <= instr->addr && instr->addr <= code->instr_size)
+      entries[instr->addr] = true;
+    else if (instr->kind == AVM_Grab)
+      entries[pc + 1] = true;
+  }
+
+  for (int pc = 0; pc < code->instr_size; ++pc) {
+    if (frames != NULL && entries[pc])
+      printf("    ; frame: stack %d, env %d\n", frames[pc].stack, frames[pc].env);
+    disassemble_instruction(code, pc);
+  }
+  free(entries);
+}
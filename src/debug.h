@@ -9,3 +9,9 @@
 
 void error(char *fmt, ... );
 void disassemble_instruction(AVM_code_t *code, int pc);
+/* Prints the whole code, for reading only: addresses are numbers,
+   not labels, and the optimizer's instructions have no syntax, so the
+   parser does not take it back. When `frames` is not NULL, every address
+   where a frame may start (the top level, closure bodies and the
+   instructions after `grab`) is preceded by the bounds of its frame. */
+void disassemble_code(AVM_code_t *code, AVM_frame_size_t *frames);
@@ -3,6 +3,7 @@
 #include "code.h"
 #include "debug.h"
 #include "interp.h"
+#include "lower.h"
 #include "memory.h"
 #include "runtime.h"
 #include "vm.h"
@@ -43,310 +44,962 @@ void print_instr(AVM_VM* vm) {
   printf("\n");
   int pc = vm->pc == 0 ? 0 : vm->pc - 1;
   disassemble_instruction(vm->code, pc);
+#ifdef DEBUG_TRACE_EXECUTION
+  printf("  astack: ");
+  print_astack(vm->astack);
+  printf(" acc: ");
+  print_value(vm->acc);
+  printf("\n  env: ");
+  print_env(vm->env);
+  printf("\n");
+#endif
+}
+
+#define STACK_BASE(array) ((AVM_value_t*)(array)->data)
+#define STACK_END(array)  (STACK_BASE(array) + (array)->capacity)
+
+/* Grows the stack `array` whose top is `top` to hold at least `room`
+   more values, and returns the new top. The new end of the stack is
+   stored in `end`. */
+static AVM_value_t *grow_stack(array_t *array, AVM_value_t *top, AVM_value_t **end,
+                               size_t room) {
+  array->size = top - STACK_BASE(array);
+  size_t capacity = ARRAY_BIGGER_CAP(array->capacity);
+  if (capacity < array->size + room)
+    capacity = array->size + room;
+  if (reserve_array(array, capacity) == ARRAY_RESERVE_FAILURE)
+    error("run: Couldn't grow a stack beyond %zu elements.", array->capacity);
+  *end = STACK_END(array);
+  return STACK_BASE(array) + array->size;
+}
+
+/* How many of the `n` arguments of an n-ary application can be bound
+   at once, the first one included: after it, `acc` and then the stack
+   below `sp` hold the next ones, and binding one pops the next. A mark
+   ends them, as does the bottom of the stack. */
+static int bindable_arguments(AVM_value_t acc, AVM_value_t *sp, AVM_value_t *base,
+                              int n) {
+  int k = 1;
+  while (k < n && sp - base >= k && !is_epsilon(k == 1 ? acc : sp[1 - k]))
+    ++k;
+  return k;
 }
 
 AVM_value_t run(AVM_VM* vm) {
 
   static void* dispatch_table[] = {
-    [AVM_Ldi]       = &&OP_AVM_Ldi,
-    [AVM_Ldb]       = &&OP_AVM_Ldb,
-    [AVM_Access]    = &&OP_AVM_Access,
-    [AVM_Closure]   = &&OP_AVM_Closure,
-    [AVM_Let]       = &&OP_AVM_Let,
-    [AVM_EndLet]    = &&OP_AVM_EndLet,
-    [AVM_Jump]      = &&OP_AVM_Jump,
-    [AVM_CJump]     = &&OP_AVM_CJump,
-    [AVM_Add]       = &&OP_AVM_Add,
-    [AVM_Sub]       = &&OP_AVM_Sub,
-    [AVM_Le]        = &&OP_AVM_Le,
-    [AVM_Eq]        = &&OP_AVM_Eq,
-    [AVM_Apply]     = &&OP_AVM_Apply,
-    [AVM_TailApply] = &&OP_AVM_TailApply,
-    [AVM_PushMark]  = &&OP_AVM_PushMark,
-    [AVM_Grab]      = &&OP_AVM_Grab,
-    [AVM_Return]    = &&OP_AVM_Return,
-    [AVM_Halt]      = &&OP_AVM_Halt,
+    [AVM_Ldi]           = &&OP_AVM_Ldi,
+    [AVM_Ldb]           = &&OP_AVM_Ldb,
+    [AVM_Access]        = &&OP_AVM_Access,
+    [AVM_Closure]       = &&OP_AVM_Closure,
+    [AVM_Let]           = &&OP_AVM_Let,
+    [AVM_EndLet]        = &&OP_AVM_EndLet,
+    [AVM_Jump]          = &&OP_AVM_Jump,
+    [AVM_CJump]         = &&OP_AVM_CJump,
+    [AVM_Add]           = &&OP_AVM_Add,
+    [AVM_Sub]           = &&OP_AVM_Sub,
+    [AVM_Le]            = &&OP_AVM_Le,
+    [AVM_Eq]            = &&OP_AVM_Eq,
+    [AVM_Apply]         = &&OP_AVM_Apply,
+    [AVM_TailApply]     = &&OP_AVM_TailApply,
+    [AVM_PushMark]      = &&OP_AVM_PushMark,
+    [AVM_Grab]          = &&OP_AVM_Grab,
+    [AVM_Return]        = &&OP_AVM_Return,
+    [AVM_Halt]          = &&OP_AVM_Halt,
+    [AVM_AddImm]        = &&OP_AVM_AddImm,
+    [AVM_SubImm]        = &&OP_AVM_SubImm,
+    [AVM_LeImm]         = &&OP_AVM_LeImm,
+    [AVM_EqImm]         = &&OP_AVM_EqImm,
+    [AVM_AccAccLeBf]    = &&OP_AVM_AccAccLeBf,
+    [AVM_AccSubImm]     = &&OP_AVM_AccSubImm,
+    [AVM_MarkAcc]       = &&OP_AVM_MarkAcc,
+    [AVM_AccApply]      = &&OP_AVM_AccApply,
+    [AVM_AccTailApply]  = &&OP_AVM_AccTailApply,
+    [AVM_BranchIfGt]    = &&OP_AVM_BranchIfGt,
+    [AVM_BranchIfNe]    = &&OP_AVM_BranchIfNe,
+    [AVM_BranchIfGtImm] = &&OP_AVM_BranchIfGtImm,
+    [AVM_BranchIfNeImm] = &&OP_AVM_BranchIfNeImm,
+    [AVM_FlatClosure]   = &&OP_AVM_FlatClosure,
+    [AVM_StaticClosure] = &&OP_AVM_StaticClosure,
+    [AVM_ApplyN]        = &&OP_AVM_ApplyN,
+    [AVM_TailApplyN]    = &&OP_AVM_TailApplyN,
+    [AVM_AccApplyN]     = &&OP_AVM_AccApplyN,
+    [AVM_AccTailApplyN] = &&OP_AVM_AccTailApplyN,
+    [AVM_CallDirect]    = &&OP_AVM_CallDirect,
+    [AVM_TailCallDirect] = &&OP_AVM_TailCallDirect,
+    [AVM_SelfTailCall]  = &&OP_AVM_SelfTailCall,
+  };
+
+  /* Entry points of verified instructions (see `init_vm`). */
+  static void* unchecked_table[] = {
+    [AVM_Ldi]           = &&OP_AVM_Ldi_unchecked,
+    [AVM_Ldb]           = &&OP_AVM_Ldb_unchecked,
+    [AVM_Access]        = &&OP_AVM_Access_unchecked,
+    [AVM_Closure]       = &&OP_AVM_Closure_unchecked,
+    [AVM_Let]           = &&OP_AVM_Let_unchecked,
+    [AVM_EndLet]        = &&OP_AVM_EndLet,
+    [AVM_Jump]          = &&OP_AVM_Jump,
+    [AVM_CJump]         = &&OP_AVM_CJump_unchecked,
+    [AVM_Add]           = &&OP_AVM_Add_unchecked,
+    [AVM_Sub]           = &&OP_AVM_Sub_unchecked,
+    [AVM_Le]            = &&OP_AVM_Le_unchecked,
+    [AVM_Eq]            = &&OP_AVM_Eq_unchecked,
+    [AVM_Apply]         = &&OP_AVM_Apply_unchecked,
+    [AVM_TailApply]     = &&OP_AVM_TailApply_unchecked,
+    [AVM_PushMark]      = &&OP_AVM_PushMark_unchecked,
+    [AVM_Grab]          = &&OP_AVM_Grab_unchecked,
+    [AVM_Return]        = &&OP_AVM_Return_unchecked,
+    [AVM_Halt]          = &&OP_AVM_Halt,
+    [AVM_AddImm]        = &&OP_AVM_AddImm_unchecked,
+    [AVM_SubImm]        = &&OP_AVM_SubImm_unchecked,
+    [AVM_LeImm]         = &&OP_AVM_LeImm_unchecked,
+    [AVM_EqImm]         = &&OP_AVM_EqImm_unchecked,
+    [AVM_AccAccLeBf]    = &&OP_AVM_AccAccLeBf_unchecked,
+    [AVM_AccSubImm]     = &&OP_AVM_AccSubImm_unchecked,
+    [AVM_MarkAcc]       = &&OP_AVM_MarkAcc_unchecked,
+    [AVM_AccApply]      = &&OP_AVM_AccApply_unchecked,
+    [AVM_AccTailApply]  = &&OP_AVM_AccTailApply_unchecked,
+    [AVM_BranchIfGt]    = &&OP_AVM_BranchIfGt_unchecked,
+    [AVM_BranchIfNe]    = &&OP_AVM_BranchIfNe_unchecked,
+    [AVM_BranchIfGtImm] = &&OP_AVM_BranchIfGtImm_unchecked,
+    [AVM_BranchIfNeImm] = &&OP_AVM_BranchIfNeImm_unchecked,
+    [AVM_FlatClosure]   = &&OP_AVM_FlatClosure_unchecked,
+    [AVM_StaticClosure] = &&OP_AVM_StaticClosure_unchecked,
+    [AVM_ApplyN]        = &&OP_AVM_ApplyN_unchecked,
+    [AVM_TailApplyN]    = &&OP_AVM_TailApplyN_unchecked,
+    [AVM_AccApplyN]     = &&OP_AVM_AccApplyN_unchecked,
+    [AVM_AccTailApplyN] = &&OP_AVM_AccTailApplyN_unchecked,
+    [AVM_CallDirect]    = &&OP_AVM_CallDirect_unchecked,
+    [AVM_TailCallDirect] = &&OP_AVM_TailCallDirect_unchecked,
+    [AVM_SelfTailCall]  = &&OP_AVM_SelfTailCall,
   };
 
-  AVM_instr_t* instr = NULL;
+  /* Resolve the handlers now that the labels are known. */
+  thread_code(vm->ops, vm->code->instr_size + 1, dispatch_table, unchecked_table);
+
+  /* The machine state lives in locals while running:
+
+     - `ip` points to the next instruction and `instr` to the current one;
+     - `acc` caches the top of the argument stack (see
+       docs/transition_table.md);
+     - `sp` is the top of `vm->astack` (the first free slot);
+     - `ep` is the top of `vm->env->cache` and `fp` the bottom of the
+       current frame in it, i.e. `cache->data + env->offset`.
+
+     SAVE() writes them back to `vm` and LOAD() reads them again. They
+     surround everything that may run the GC or inspect the VM. */
+  AVM_op_t* ip = vm->ops + vm->pc;
+  AVM_op_t* instr = NULL;
+  AVM_value_t acc = vm->acc;
+  AVM_value_t *sp, *sp_end, *ep, *ep_end, *fp;
+  /* Operands of `apply` and `tail_apply`, shared with superinstructions,
+     and the number of arguments an n-ary application binds at once. */
+  AVM_value_t func, arg;
+  int nargs;
+
+#define SAVE()                                                  \
+  do {                                                          \
+    vm->pc = (int)(ip - vm->ops);                               \
+    vm->acc = acc;                                              \
+    vm->astack->size = sp - STACK_BASE(vm->astack);             \
+    vm->env->cache->size = ep - STACK_BASE(vm->env->cache);     \
+  } while (0)
+#define LOAD()                                                  \
+  do {                                                          \
+    acc = vm->acc;                                              \
+    sp = STACK_BASE(vm->astack) + vm->astack->size;             \
+    sp_end = STACK_END(vm->astack);                             \
+    ep = STACK_BASE(vm->env->cache) + vm->env->cache->size;     \
+    ep_end = STACK_END(vm->env->cache);                         \
+    fp = STACK_BASE(vm->env->cache) + vm->env->offset;          \
+  } while (0)
+#define FAIL(...)                                               \
+  do {                                                          \
+    SAVE();                                                     \
+    error(__VA_ARGS__);                                         \
+  } while (0)
+
 #define DISPATCH()                                        \
   do {                                                    \
-    instr = vm->code->instr + vm->pc;                     \
-    goto *dispatch_table[vm->code->instr[vm->pc++].kind]; \
-} while (0)
+    instr = ip++;                                         \
+    goto *instr->handler;                                 \
+  } while (0)
+#define PC() ((int)(ip - vm->ops))
+
+  /* Argument stack. Pushes never check the capacity: each frame
+     reserves its space on entry (see RESERVE), and handlers that are
+     not verified check for room first. */
+#define PUSH(v) (*sp++ = (v))
+#define CHECK_ROOM(n)                                           \
+  do {                                                          \
+    if (sp_end - sp < (n))                                      \
+      sp = grow_stack(vm->astack, sp, &sp_end, (n));            \
+  } while (0)
+#define APOP(dst)                                               \
+  do {                                                          \
+    if (sp == STACK_BASE(vm->astack))                           \
+      FAIL("%s: The argument stack is empty.", __func__);       \
+    (dst) = *--sp;                                              \
+  } while (0)
+  /* Pushes the accumulator, making room for a new top. */
+#define PUSH_ACC() PUSH(acc)
+  /* Pops without checking; guarded by CHECK_POP or the verifier. */
+#define POP(dst) ((dst) = *--sp)
+#define CHECK_POP(name, n)                                      \
+  do {                                                          \
+    if (sp - STACK_BASE(vm->astack) < (n))                      \
+      FAIL("%s: The argument stack is empty.", name);           \
+  } while (0)
+
+  /* Environment cache, reserved like the argument stack */
+#define EXTEND(v) (*ep++ = (v))
+#define CHECK_ENV_ROOM(n)                                       \
+  do {                                                          \
+    if (ep_end - ep < (n)) {                                    \
+      ep = grow_stack(vm->env->cache, ep, &ep_end, (n));        \
+      fp = STACK_BASE(vm->env->cache) + vm->env->offset;        \
+    }                                                           \
+  } while (0)
+  /* Makes room for a frame entered at `addr`. */
+#define RESERVE(addr)                                           \
+  do {                                                          \
+    AVM_frame_size_t *_fs = &vm->frames[addr];                  \
+    CHECK_ROOM(_fs->stack);                                     \
+    CHECK_ENV_ROOM(_fs->env);                                   \
+  } while (0)
+#define LOOKUP(dst, index)                                      \
+  do {                                                          \
+    size_t _i = (index);                                        \
+    size_t _live = ep - fp;                                     \
+    if (_i < _live) {                                           \
+      (dst) = ep[-1 - (ptrdiff_t)_i];                           \
+    } else {                                                    \
+      (dst) = penv_lookup(vm->env->penv, vm->env->live, _i - _live); \
+    }                                                           \
+  } while (0)
+
+  /* Pushes the return frame of an application and starts a new frame
+     in the environment cache and in the region. */
+#define CALL(name)                                              \
+  do {                                                          \
+    AVM_ret_frame_t _frame = { .addr = PC(),                    \
+                               .live = vm->env->live,           \
+                               .penv = vm->env->penv,           \
+                               .offset = vm->env->offset,       \
+                               .region = vm->region_base };     \
+    if (!rpush(vm->rstack, _frame))                             \
+      FAIL("%s: Couldn't push the return address", name);       \
+    fp = ep;                                                    \
+    vm->env->offset = fp - STACK_BASE(vm->env->cache);          \
+    vm->region_base = vm->region_top;                           \
+  } while (0)
+  /* Frees the region of a frame that ends or starts over. */
+#define RESET_REGION() (vm->region_top = vm->region_base)
+  /* Frees the region of the frame returning to `ret_frame`. */
+#define RETURN_REGION(ret_frame)                                \
+  do {                                                          \
+    vm->region_top = vm->region_base;                           \
+    vm->region_base = (ret_frame)->region;                      \
+  } while (0)
+
+#define CHECK_BOUND(name, index)                                \
+  do {                                                          \
+    if ((size_t)(index) >= (size_t)(ep - fp) + penv_size(vm->env->penv, vm->env->live)) \
+      FAIL("%s: Unbound variable %d.", name, (int)(index));     \
+  } while (0)
+#define CHECK_CLOS(name, v)                                     \
+  do {                                                          \
+    if (!is_obj(v) || (as_obj(v)->kind != AVM_ObjClos &&        \
+                       as_obj(v)->kind != AVM_ObjPap))          \
+      FAIL("%s: Expected function application.", name);         \
+  } while (0)
+
   /* Debug is disabled now. */
 #ifdef DEBUG_TRACE_EXECUTION
-#define DEBUG_MESSAGE() print_instr(vm)
+#define DEBUG_MESSAGE() do { SAVE(); print_instr(vm); } while (0)
 #else
 #define DEBUG_MESSAGE()
 #endif
 
+  LOAD();
+  RESERVE(vm->pc);
   DISPATCH();
-  
+
+  /* Handlers with runtime checks have two entry points: `OP_<kind>`
+     performs the checks and falls through to `OP_<kind>_unchecked`,
+     which verified instructions enter directly (see src/verify.c). */
+
  OP_AVM_Ldi:
+  CHECK_ROOM(1);
+ OP_AVM_Ldi_unchecked:
   DEBUG_MESSAGE();
-  if (!apush(vm->astack, new_int(vm, instr->const_int)))
-    error("AVM_Ldi: Couldn't push %d.", instr->const_int);
+  PUSH_ACC();
+  acc = new_int(vm, instr->operand);
   DISPATCH();
 
  OP_AVM_Ldb:
+  CHECK_ROOM(1);
+ OP_AVM_Ldb_unchecked:
   DEBUG_MESSAGE();
-  if (!apush(vm->astack, new_bool(vm, instr->const_bool)))
-    error("AVM_Ldb: Couldn't push %s.", instr->const_bool ? "true" : "false");
+  PUSH_ACC();
+  acc = new_bool(vm, instr->operand);
   DISPATCH();
 
- OP_AVM_Access: {
+ OP_AVM_Access:
+  CHECK_BOUND("AVM_Access", instr->operand);
+  CHECK_ROOM(1);
+ OP_AVM_Access_unchecked:
+  DEBUG_MESSAGE();
+  PUSH_ACC();
+  LOOKUP(acc, instr->operand);
+  DISPATCH();
+
+ OP_AVM_Closure:
+  CHECK_ROOM(1);
+ OP_AVM_Closure_unchecked: {
     DEBUG_MESSAGE();
-    /* To be confirmed: `lookup` is total? */
-    AVM_value_t val = lookup(vm->env, instr->access);
-    if (!apush(vm->astack, val))
-      error("AVM_Access: Couldn't push the found value.");
+    PUSH_ACC();
+    SAVE();
+    perpetuate(vm, vm->env);
+    vm->acc = (instr->flags & AVM_OP_REGION)
+      ? new_region_clos(vm, instr->operand, vm->env->penv, vm->env->live)
+      : new_clos(vm, instr->operand, vm->env->penv, vm->env->live);
+    LOAD();
     DISPATCH();
   }
 
- OP_AVM_Closure: {
+ OP_AVM_FlatClosure:
+  if (instr->index[0] > 0)
+    CHECK_POP("AVM_FlatClosure", instr->index[0] - 1);
+ OP_AVM_FlatClosure_unchecked: {
+    // The top `n` values become the environment of the closure.
     DEBUG_MESSAGE();
-    perpetuate(vm, vm->env);
-    AVM_value_t clos = new_clos(vm, instr->addr, vm->env->penv);
-    if (!apush(vm->astack, clos))
-      error("AVM_CLosure: Couldn't push the closure.");
+    size_t n = instr->index[0];
+    CHECK_ROOM(1);
+    PUSH_ACC();
+    SAVE();
+    AVM_value_t clos = (instr->flags & AVM_OP_REGION)
+      ? new_region_flat_clos(vm, instr->operand, sp - n, n)
+      : new_flat_clos(vm, instr->operand, sp - n, n);
+    LOAD();
+    sp -= n;
+    acc = clos;
     DISPATCH();
   }
 
+ OP_AVM_StaticClosure:
+  CHECK_ROOM(1);
+ OP_AVM_StaticClosure_unchecked:
+  DEBUG_MESSAGE();
+  PUSH_ACC();
+  acc = vm->statics[instr->operand];
+  DISPATCH();
+
  OP_AVM_Let:
+  CHECK_POP("AVM_Let", 1);
+  CHECK_ENV_ROOM(1);
+ OP_AVM_Let_unchecked:
   DEBUG_MESSAGE();
-  vm->env = extend(vm->env, apop(vm->astack));
-  if (vm->env == NULL)
-    error("AVM_Let: Couldn't extend the environment.");
+  EXTEND(acc);
+  POP(acc);
   DISPATCH();
 
  OP_AVM_EndLet:
   DEBUG_MESSAGE();
-  remove_head(vm, vm->env);
+  if (ep > fp) {
+    --ep;
+  } else {
+    SAVE();
+    remove_head(vm->env);
+    LOAD();
+  }
   DISPATCH();
 
  OP_AVM_Jump:
   DEBUG_MESSAGE();
-  vm->pc = instr->addr;
+  ip = vm->ops + instr->operand;
   DISPATCH();
 
- OP_AVM_CJump: {
-    DEBUG_MESSAGE();
-    AVM_value_t val = apop(vm->astack);
-    if (!is_bool(val)) {
-      error("AVM_CJump: Expected a bool value.");
-    } else if (!as_bool(val)) {
-      vm->pc = instr->addr;
-    }
-    DISPATCH();
+ OP_AVM_CJump:
+  CHECK_POP("AVM_CJump", 1);
+  if (!is_bool(acc)) {
+    FAIL("AVM_CJump: Expected a bool value.");
   }
+ OP_AVM_CJump_unchecked:
+  DEBUG_MESSAGE();
+  if (!as_bool(acc))
+    ip = vm->ops + instr->operand;
+  POP(acc);
+  DISPATCH();
 
- OP_AVM_Add: {
+ OP_AVM_Add:
+  CHECK_POP("AVM_Add", 1);
+  if (!is_int(acc) || !is_int(sp[-1])) {
+    FAIL("AVM_Add: Expected two integer values.");
+  }
+ OP_AVM_Add_unchecked: {
     DEBUG_MESSAGE();
-    AVM_value_t val1 = apop(vm->astack);
-    AVM_value_t val2 = apop(vm->astack);
-
-    if (!is_int(val1) || !is_int(val2)) {
-      error("AVM_Add: Expected two integer values.");
-    }
-
-    if (!apush(vm->astack, new_int(vm, as_int(val1) + as_int(val2)))) // x + y
-      error("AVM_Add: Couldn't push the result.");
+    AVM_value_t val2;
+    POP(val2);
+    acc = new_int(vm, as_int(acc) + as_int(val2)); // x + y
     DISPATCH();
   }
 
- OP_AVM_Sub: {
+ OP_AVM_Sub:
+  CHECK_POP("AVM_Sub", 1);
+  if (!is_int(acc) || !is_int(sp[-1])) {
+    FAIL("AVM_Sub: Expected two integer values.");
+  }
+ OP_AVM_Sub_unchecked: {
     DEBUG_MESSAGE();
-    AVM_value_t val1 = apop(vm->astack); // y
-    AVM_value_t val2 = apop(vm->astack); // x
-
-    if (!is_int(val1) || !is_int(val2)) {
-      error("AVM_Sub: Expected two integer values.");
-    }
-
-    if (!apush(vm->astack, new_int(vm, as_int(val2) - as_int(val1)))) // x - y
-      error("AVM_Sub: Couldn't push the result.");
+    AVM_value_t val2; // x
+    POP(val2);
+    acc = new_int(vm, as_int(val2) - as_int(acc)); // x - y
     DISPATCH();
   }
 
- OP_AVM_Le: {
+ OP_AVM_Le:
+  CHECK_POP("AVM_Le", 1);
+  if (!is_int(acc) || !is_int(sp[-1])) {
+    FAIL("AVM_Le: Expected two integer values.");
+  }
+ OP_AVM_Le_unchecked: {
     DEBUG_MESSAGE();
-    AVM_value_t val1 = apop(vm->astack); // y
-    AVM_value_t val2 = apop(vm->astack); // x
-
-    if (!is_int(val1) || !is_int(val2)) {
-      error("AVM_Le: Expected two integer values.");
-    }
-
-    if (!apush(vm->astack, new_bool(vm, as_int(val2) <= as_int(val1)))) // x <= y
-      error("AVM_Le: Couldn't push the result.");
+    AVM_value_t val2; // x
+    POP(val2);
+    acc = new_bool(vm, as_int(val2) <= as_int(acc)); // x <= y
     DISPATCH();
   }
 
- OP_AVM_Eq: {
+ OP_AVM_Eq:
+  CHECK_POP("AVM_Eq", 1);
+  if (!is_int(acc) || !is_int(sp[-1])) {
+    FAIL("AVM_Eq: Expected two integer values.");
+  }
+ OP_AVM_Eq_unchecked: {
     DEBUG_MESSAGE();
-    AVM_value_t val1 = apop(vm->astack);
-    AVM_value_t val2 = apop(vm->astack);
-
-    if (!is_int(val1) || !is_int(val2)) {
-      error("AVM_Eq: Expected two integer values.");
-    }
-
-    if (!apush(vm->astack, new_bool(vm, as_int(val1) == as_int(val2)))) // x == y
-      error("AVM_Eq: Couldn't push the result.");
+    AVM_value_t val2;
+    POP(val2);
+    acc = new_bool(vm, as_int(acc) == as_int(val2)); // x == y
     DISPATCH();
   }
 
- OP_AVM_Apply: {
-    DEBUG_MESSAGE();
-    // Pop a function and an argument from astack.
-    AVM_value_t func = apop(vm->astack);
-    AVM_value_t arg = apop(vm->astack);
-
-    AVM_object_t *obj = as_obj(func);
-
-    if (!is_obj(func) || obj->kind != AVM_ObjClos) {
-      error("AVM_Apply: Expected function application.");
-    }
-
-    AVM_clos_t *clos = (AVM_clos_t*)(obj + 1);
-
-    // Push the current address and the environment to rstack.
-    AVM_ret_frame_t *new_frame = malloc(sizeof(AVM_ret_frame_t));
-    new_frame->addr = vm->pc;
-    new_frame->penv = vm->env->penv;
-    new_frame->offset = vm->env->offset;
-    if (!rpush(vm->rstack, new_frame))
-      error("AVM_Apply: Couldn't push the return address");
-
-    // Extend the environment.
-    vm->env->offset = vm->env->cache->size;
-    vm->env->penv = clos->penv;
-    if (extend(vm->env, func) == NULL)
-      error("AVM_Apply: Couldn't extend the environment.");
-    if (extend(vm->env, arg) == NULL)
-      error("AVM_Apply: Couldn't extend the environment.");
+ OP_AVM_AddImm:
+  if (!is_int(acc)) {
+    FAIL("AVM_AddImm: Expected an integer value.");
+  }
+ OP_AVM_AddImm_unchecked:
+  DEBUG_MESSAGE();
+  acc = new_int(vm, as_int(acc) + instr->operand); // x + k
+  DISPATCH();
 
-    // Jump to the given address.
-    vm->pc = clos->addr;
-    DISPATCH();
+ OP_AVM_SubImm:
+  if (!is_int(acc)) {
+    FAIL("AVM_SubImm: Expected an integer value.");
   }
+ OP_AVM_SubImm_unchecked:
+  DEBUG_MESSAGE();
+  acc = new_int(vm, as_int(acc) - instr->operand); // x - k
+  DISPATCH();
 
- OP_AVM_TailApply: {
-    DEBUG_MESSAGE();
-    // Pop a function and an argument from astack.
-    AVM_value_t func = apop(vm->astack);
-    AVM_value_t arg = apop(vm->astack);
+ OP_AVM_LeImm:
+  if (!is_int(acc)) {
+    FAIL("AVM_LeImm: Expected an integer value.");
+  }
+ OP_AVM_LeImm_unchecked:
+  DEBUG_MESSAGE();
+  acc = new_bool(vm, as_int(acc) <= instr->operand); // x <= k
+  DISPATCH();
 
-    AVM_object_t *obj = as_obj(func);
+ OP_AVM_EqImm:
+  if (!is_int(acc)) {
+    FAIL("AVM_EqImm: Expected an integer value.");
+  }
+ OP_AVM_EqImm_unchecked:
+  DEBUG_MESSAGE();
+  acc = new_bool(vm, as_int(acc) == instr->operand); // x == k
+  DISPATCH();
 
-    if (!is_obj(func) || obj->kind != AVM_ObjClos) {
-      error("AVM_Apply: Expected function application.");
+ OP_AVM_Apply:
+  CHECK_POP("AVM_Apply", 2);
+  CHECK_CLOS("AVM_Apply", acc);
+ OP_AVM_Apply_unchecked:
+  DEBUG_MESSAGE();
+  // Pop a function and an argument from astack.
+  func = acc;
+  POP(arg);
+  POP(acc);
+
+ apply:
+  // Push the current address and the environment to rstack.
+  CALL("AVM_Apply");
+  goto enter;
+
+ OP_AVM_TailApply:
+  CHECK_POP("AVM_TailApply", 2);
+  CHECK_CLOS("AVM_TailApply", acc);
+ OP_AVM_TailApply_unchecked:
+  DEBUG_MESSAGE();
+  // Pop a function and an argument from astack.
+  func = acc;
+  POP(arg);
+  POP(acc);
+
+ tail_apply:
+  // Reset the current frame.
+  ep = fp;
+  RESET_REGION();
+
+ enter: {
+    if (as_obj(func)->kind == AVM_ObjPap) {
+      /* Bind the arguments again as the grabs did, then the new one as
+         the grab that returned the PAP would have, and go on after it. */
+      AVM_pap_t *pap = (AVM_pap_t*)(as_obj(func) + 1);
+      AVM_clos_t *clos = (AVM_clos_t*)(as_obj(pap->clos) + 1);
+      vm->env->penv = clos->penv;
+      vm->env->live = clos->live;
+      RESERVE(clos->addr);
+      CHECK_ENV_ROOM(2 * pap->size + 2);
+      EXTEND(pap->clos);
+      EXTEND(pap->args[0]);
+      for (uint32_t i = 1; i < pap->size; ++i) {
+        EXTEND(epsilon);
+        EXTEND(pap->args[i]);
+      }
+      EXTEND(epsilon);
+      EXTEND(arg);
+      ip = vm->ops + clos->addr + pap->size;
+      DISPATCH();
     }
 
-    AVM_clos_t *clos = (AVM_clos_t*)(obj + 1);
+    AVM_clos_t *clos = (AVM_clos_t*)(as_obj(func) + 1);
 
     // Extend the environment.
-    /* vm->env->offset = vm->env->cache.size; */
-    pop_array_n(vm->env->cache, vm->env->cache->size - vm->env->offset);
     vm->env->penv = clos->penv;
-    if (extend(vm->env, func) == NULL)
-      error("AVM_Apply: Couldn't extend the environment.");
-    if (extend(vm->env, arg) == NULL)
-      error("AVM_Apply: Couldn't extend the environment.");
+    vm->env->live = clos->live;
+    RESERVE(clos->addr);
+    EXTEND(func);
+    EXTEND(arg);
 
     // Jump to the given address.
-    vm->pc = clos->addr;
+    ip = vm->ops + clos->addr;
     DISPATCH();
   }
 
  OP_AVM_PushMark:
+  CHECK_ROOM(1);
+ OP_AVM_PushMark_unchecked:
   DEBUG_MESSAGE();
-  if (!apush(vm->astack, epsilon))
-    error("AVM_PushMark: Couldn't push the mark.");
+  PUSH_ACC();
+  acc = epsilon;
   DISPATCH();
 
- OP_AVM_Grab: {
+ OP_AVM_Grab:
+  if (!is_epsilon(acc)) {
+    CHECK_POP("AVM_Grab", 1);
+    CHECK_ENV_ROOM(2);
+  }
+ OP_AVM_Grab_unchecked: {
     DEBUG_MESSAGE();
     // Pop an argument.
-    AVM_value_t arg = apop(vm->astack);
+    AVM_value_t arg = acc;
 
     if (is_epsilon(arg)) {
-      // Push the current address to astack.
-      perpetuate(vm, vm->env);
-      AVM_value_t tmp = new_clos(vm, vm->pc, vm->env->penv);
-      if (!apush(vm->astack, tmp))
-	error("AVM_Grab: Couldn't push the current address.");
+      SAVE();
+      /* The `j`-th grab of the running closure's leading chain has only
+         the closure and its arguments in the frame, so a PAP of them
+         replaces the mark. Elsewhere, a closure of the rest of the code
+         does, capturing the whole environment. */
+      AVM_value_t self = ep - fp >= 2 ? fp[0] : VAL_NONE;
+      AVM_clos_t *clos = is_obj(self) && as_obj(self)->kind == AVM_ObjClos
+        ? (AVM_clos_t*)(as_obj(self) + 1) : NULL;
+      int j = clos != NULL ? (int)(instr - vm->ops) - clos->addr : -1;
+      if (0 <= j && j <= instr->operand && ep - fp == 2 + 2 * j &&
+          clos->penv == vm->env->penv && clos->live == vm->env->live) {
+        vm->acc = new_pap(vm, fp, j + 1);
+        vm->env->cache->size = vm->env->offset;
+      } else {
+        perpetuate(vm, vm->env);
+        vm->acc = new_clos(vm, PC(), vm->env->penv, vm->env->live);
+      }
 
       // Get the caller's address.
       AVM_ret_frame_t *ret_frame = rpop(vm->rstack);
       if (ret_frame == NULL)
-	error("AVM_Grab: Couldn't get the caller's address.");
+	FAIL("AVM_Grab: Couldn't get the caller's address.");
 
       // Jump back to the caller.
-      vm->pc = ret_frame->addr;
+      ip = vm->ops + ret_frame->addr;
+      RETURN_REGION(ret_frame);
       vm->env->penv = ret_frame->penv;
+      vm->env->live = ret_frame->live;
       vm->env->offset = ret_frame->offset;
-
-      free(ret_frame);
+      LOAD();
     } else {
       // Extend the current environment and continue.
-      /* perpetuate(vm->env); */
-      /* AVM_value_t *tmp = new_clos(vm, vm->pc, vm->env); */
-      /* if (tmp == NULL) */
-      /*   error("AVM_Grab: Couldn't create a new closure."); */
       // Note: we do NOT allow recursive call to curried function.
-      if (extend(vm->env, epsilon) == NULL)
-	error("AVM_Grab: Couldn't extend the environment.");
-      if (extend(vm->env, arg) == NULL)
-	error("AVM_Grab: Couldn't extend the environment.");
+      EXTEND(epsilon);
+      EXTEND(arg);
+      POP(acc);
     }
     DISPATCH();
   }
 
- OP_AVM_Return: {
+ OP_AVM_Return:
+  CHECK_POP("AVM_Return", 1);
+ OP_AVM_Return_unchecked: {
     DEBUG_MESSAGE();
     // Pop two arguments.
-    AVM_value_t arg1 = apop(vm->astack);
-    AVM_value_t arg2 = apop(vm->astack);
+    AVM_value_t arg1 = acc;
+    AVM_value_t arg2;
+    POP(arg2);
     AVM_object_t *obj;
 
     if (is_epsilon(arg2)) {
-      // Push the first argument to astack.
-      if (!apush(vm->astack, arg1))
-	error("AVM_Return: Couldn't push the result to the argument stack.");
+      // The result stays in the accumulator.
 
       // Get the caller's address.
       AVM_ret_frame_t *ret_frame = rpop(vm->rstack);
       if (ret_frame == NULL)
-	error("AVM_Return: Couldn't get the caller's address.");
+	FAIL("AVM_Return: Couldn't get the caller's address.");
 
       // Jump back to the caller.
-      vm->pc = ret_frame->addr;
+      ip = vm->ops + ret_frame->addr;
+      RETURN_REGION(ret_frame);
       vm->env->penv = ret_frame->penv;
-      pop_array_n(vm->env->cache, vm->env->cache->size - vm->env->offset);
+      vm->env->live = ret_frame->live;
+      ep = fp;
       vm->env->offset = ret_frame->offset;
-      free(ret_frame);
-    } else if ((obj = as_obj(arg1)) || obj->kind != AVM_ObjClos) {
-      error("AVM_Return: Invalid return address.");
+      fp = STACK_BASE(vm->env->cache) + vm->env->offset;
+    } else if (!is_obj(arg1) || ((obj = as_obj(arg1))->kind != AVM_ObjClos &&
+                                  obj->kind != AVM_ObjPap)) {
+      FAIL("AVM_Return: Invalid return address.");
     } else {
-      AVM_clos_t *clos = (AVM_clos_t*)(obj + 1);
+      /* Pop all the contents of the current cache and apply arg1 to arg2
+         in its place. */
+      func = arg1;
+      arg = arg2;
+      APOP(acc);
+      goto tail_apply;
+    }
+    DISPATCH();
+  }
 
-      /* Pop all the contents of the current cache, change the penv to that of arg1,
-	 and extend the environment. */
-      pop_array_n(vm->env->cache, vm->env->cache->size - vm->env->offset);
-      vm->env->penv = clos->penv;
-      if (extend(vm->env, arg1) == NULL)
-	error("AVM_Return: Couldn't extend the environment.");
-      if (extend(vm->env, arg2) == NULL)
-	error("AVM_Grab: Couldn't extend the environment.");
-      vm->pc = clos->addr;
+ /* Superinstructions (see src/optimize.c) */
+
+ OP_AVM_AccAccLeBf: {
+    AVM_value_t val1, val2;
+    CHECK_BOUND("AVM_AccAccLeBf", instr->index[0]);
+    CHECK_BOUND("AVM_AccAccLeBf", instr->index[1]);
+    LOOKUP(val2, instr->index[0]);
+    LOOKUP(val1, instr->index[1]);
+    if (!is_int(val1) || !is_int(val2)) {
+      FAIL("AVM_AccAccLeBf: Expected two integer values.");
+    }
+  }
+ OP_AVM_AccAccLeBf_unchecked: {
+    // acc n; acc m; le; bf L, leaving the stack as it was.
+    DEBUG_MESSAGE();
+    AVM_value_t val1, val2;
+    LOOKUP(val2, instr->index[0]); // x
+    LOOKUP(val1, instr->index[1]); // y
+
+    if (!(as_int(val2) <= as_int(val1))) // x <= y
+      ip = vm->ops + instr->operand;
+    DISPATCH();
+  }
+
+ OP_AVM_AccSubImm: {
+    AVM_value_t val;
+    CHECK_BOUND("AVM_AccSubImm", instr->index[0]);
+    CHECK_ROOM(1);
+    LOOKUP(val, instr->index[0]);
+    if (!is_int(val)) {
+      FAIL("AVM_AccSubImm: Expected an integer value.");
     }
+  }
+ OP_AVM_AccSubImm_unchecked: {
+    // acc n; subi k
+    DEBUG_MESSAGE();
+    AVM_value_t val;
+    PUSH_ACC();
+    LOOKUP(val, instr->index[0]);
+    acc = new_int(vm, as_int(val) - instr->operand);
     DISPATCH();
   }
 
+ OP_AVM_MarkAcc:
+  CHECK_BOUND("AVM_MarkAcc", instr->operand);
+  CHECK_ROOM(2);
+ OP_AVM_MarkAcc_unchecked:
+  // mark; acc n
+  DEBUG_MESSAGE();
+  PUSH_ACC();
+  PUSH(epsilon);
+  LOOKUP(acc, instr->operand);
+  DISPATCH();
+
+ OP_AVM_AccApply:
+  CHECK_BOUND("AVM_AccApply", instr->operand);
+  CHECK_POP("AVM_AccApply", 1);
+  LOOKUP(func, instr->operand);
+  CHECK_CLOS("AVM_AccApply", func);
+ OP_AVM_AccApply_unchecked:
+  // acc k; app
+  DEBUG_MESSAGE();
+  LOOKUP(func, instr->operand);
+  arg = acc;
+  POP(acc);
+  goto apply;
+
+ OP_AVM_AccTailApply:
+  CHECK_BOUND("AVM_AccTailApply", instr->operand);
+  CHECK_POP("AVM_AccTailApply", 1);
+  LOOKUP(func, instr->operand);
+  CHECK_CLOS("AVM_AccTailApply", func);
+ OP_AVM_AccTailApply_unchecked:
+  // acc k; tapp
+  DEBUG_MESSAGE();
+  LOOKUP(func, instr->operand);
+  arg = acc;
+  POP(acc);
+  goto tail_apply;
+
+ /* N-ary applications (see src/optimize.c): as `app` and the like,
+    except that the callee is entered past the leading grabs that
+    would bind its next `nargs - 1` arguments. Unverified, `nargs` only
+    counts the arguments that are there, up to the first mark, and the
+    application is a plain one if there is no other. */
+
+ OP_AVM_ApplyN:
+  CHECK_POP("AVM_ApplyN", 2);
+  CHECK_CLOS("AVM_ApplyN", acc);
+  nargs = bindable_arguments(sp[-2], sp - 2, STACK_BASE(vm->astack), instr->operand);
+  if (nargs < 2)
+    goto OP_AVM_Apply_unchecked;
+  goto apply_n;
+ OP_AVM_ApplyN_unchecked:
+  nargs = instr->operand;
+ apply_n:
+  DEBUG_MESSAGE();
+  func = acc;
+  POP(arg);
+  POP(acc);
+ call_n:
+  CALL("AVM_ApplyN");
+  goto enter_n;
+
+ OP_AVM_TailApplyN:
+  CHECK_POP("AVM_TailApplyN", 2);
+  CHECK_CLOS("AVM_TailApplyN", acc);
+  nargs = bindable_arguments(sp[-2], sp - 2, STACK_BASE(vm->astack), instr->operand);
+  if (nargs < 2)
+    goto OP_AVM_TailApply_unchecked;
+  goto tail_apply_n;
+ OP_AVM_TailApplyN_unchecked:
+  nargs = instr->operand;
+ tail_apply_n:
+  DEBUG_MESSAGE();
+  func = acc;
+  POP(arg);
+  POP(acc);
+ tail_call_n:
+  ep = fp;
+  RESET_REGION();
+
+ enter_n: {
+    /* A callee with fewer leading grabs is rare; its grabs bind what
+       they can and `ret` passes the rest on. */
+    AVM_clos_t *clos = (AVM_clos_t*)(as_obj(func) + 1);
+    if (as_obj(func)->kind == AVM_ObjPap || vm->frames[clos->addr].arity < nargs)
+      goto enter;
+
+    vm->env->penv = clos->penv;
+    vm->env->live = clos->live;
+    RESERVE(clos->addr);
+    CHECK_ENV_ROOM(2 * nargs);
+    EXTEND(func);
+    EXTEND(arg);
+    // Bind the other arguments as the grabs would.
+    EXTEND(epsilon);
+    EXTEND(acc);
+    for (int i = 1; i < nargs - 1; ++i) {
+      EXTEND(epsilon);
+      EXTEND(sp[-i]);
+    }
+    sp -= nargs - 1;
+    acc = *sp;
+
+    ip = vm->ops + clos->addr + nargs - 1;
+    DISPATCH();
+  }
+
+ OP_AVM_AccApplyN:
+  CHECK_BOUND("AVM_AccApplyN", instr->operand);
+  CHECK_POP("AVM_AccApplyN", 1);
+  LOOKUP(func, instr->operand);
+  CHECK_CLOS("AVM_AccApplyN", func);
+  nargs = bindable_arguments(sp[-1], sp - 1, STACK_BASE(vm->astack), instr->index[0]);
+  if (nargs < 2)
+    goto OP_AVM_AccApply_unchecked;
+  goto acc_apply_n;
+ OP_AVM_AccApplyN_unchecked:
+  nargs = instr->index[0];
+ acc_apply_n:
+  // acc k; ApplyN n
+  DEBUG_MESSAGE();
+  LOOKUP(func, instr->operand);
+  arg = acc;
+  POP(acc);
+  goto call_n;
+
+ OP_AVM_AccTailApplyN:
+  CHECK_BOUND("AVM_AccTailApplyN", instr->operand);
+  CHECK_POP("AVM_AccTailApplyN", 1);
+  LOOKUP(func, instr->operand);
+  CHECK_CLOS("AVM_AccTailApplyN", func);
+  nargs = bindable_arguments(sp[-1], sp - 1, STACK_BASE(vm->astack), instr->index[0]);
+  if (nargs < 2)
+    goto OP_AVM_AccTailApply_unchecked;
+  goto acc_tail_apply_n;
+ OP_AVM_AccTailApplyN_unchecked:
+  nargs = instr->index[0];
+ acc_tail_apply_n:
+  // acc k; TailApplyN n
+  DEBUG_MESSAGE();
+  LOOKUP(func, instr->operand);
+  arg = acc;
+  POP(acc);
+  goto tail_call_n;
+
+ /* Direct calls (see src/optimize.c): the callee is the static closure
+    of the operand, whose address and empty environment are known, so
+    nothing is looked up or checked. `init_vm` bounds `nargs` by its
+    arity. */
+
+ OP_AVM_CallDirect:
+  CHECK_POP("AVM_CallDirect", 1);
+  nargs = bindable_arguments(sp[-1], sp - 1, STACK_BASE(vm->astack), instr->index[0]);
+  goto call_direct;
+ OP_AVM_CallDirect_unchecked:
+  nargs = instr->index[0];
+ call_direct:
+  DEBUG_MESSAGE();
+  arg = acc;
+  POP(acc);
+  CALL("AVM_CallDirect");
+  goto enter_direct;
+
+ OP_AVM_TailCallDirect:
+  CHECK_POP("AVM_TailCallDirect", 1);
+  nargs = bindable_arguments(sp[-1], sp - 1, STACK_BASE(vm->astack), instr->index[0]);
+  goto tail_call_direct;
+ OP_AVM_TailCallDirect_unchecked:
+  nargs = instr->index[0];
+ tail_call_direct:
+  DEBUG_MESSAGE();
+  arg = acc;
+  POP(acc);
+  ep = fp;
+  RESET_REGION();
+
+ enter_direct:
+  vm->env->penv = NULL;
+  vm->env->live = 0;
+  RESERVE(instr->operand);
+  CHECK_ENV_ROOM(2 * nargs);
+  EXTEND(vm->statics[instr->operand]);
+  EXTEND(arg);
+  if (nargs > 1) {
+    EXTEND(epsilon);
+    EXTEND(acc);
+    for (int i = 1; i < nargs - 1; ++i) {
+      EXTEND(epsilon);
+      EXTEND(sp[-i]);
+    }
+    sp -= nargs - 1;
+    acc = *sp;
+  }
+  ip = vm->ops + instr->operand + nargs - 1;
+  DISPATCH();
+
+ OP_AVM_SelfTailCall: {
+    /* A direct tail call of the running closure, which only `init_vm`
+       produces from verified code: the frame still holds the closure
+       and the marks between its arguments, so they stay, and the new
+       arguments replace the old ones. */
+    DEBUG_MESSAGE();
+    int n = instr->index[0];
+    ip = vm->ops + instr->operand;
+    ep = fp + 2 * n;
+    RESET_REGION();
+    for (int i = 0; i < n; ++i) {
+      fp[2 * i + 1] = acc;
+      POP(acc);
+    }
+    DISPATCH();
+  }
+
+ OP_AVM_BranchIfGt:
+  CHECK_POP("AVM_BranchIfGt", 2);
+  if (!is_int(acc) || !is_int(sp[-1])) {
+    FAIL("AVM_BranchIfGt: Expected two integer values.");
+  }
+ OP_AVM_BranchIfGt_unchecked: {
+    // le; bf L
+    DEBUG_MESSAGE();
+    AVM_value_t val2; // x
+    POP(val2);
+    if (as_int(val2) > as_int(acc)) // !(x <= y)
+      ip = vm->ops + instr->operand;
+    POP(acc);
+    DISPATCH();
+  }
+
+ OP_AVM_BranchIfNe:
+  CHECK_POP("AVM_BranchIfNe", 2);
+  if (!is_int(acc) || !is_int(sp[-1])) {
+    FAIL("AVM_BranchIfNe: Expected two integer values.");
+  }
+ OP_AVM_BranchIfNe_unchecked: {
+    // eq; bf L
+    DEBUG_MESSAGE();
+    AVM_value_t val2;
+    POP(val2);
+    if (as_int(acc) != as_int(val2)) // !(x == y)
+      ip = vm->ops + instr->operand;
+    POP(acc);
+    DISPATCH();
+  }
+
+ OP_AVM_BranchIfGtImm:
+  CHECK_POP("AVM_BranchIfGtImm", 1);
+  if (!is_int(acc)) {
+    FAIL("AVM_BranchIfGtImm: Expected an integer value.");
+  }
+ OP_AVM_BranchIfGtImm_unchecked:
+  // lei k; bf L
+  DEBUG_MESSAGE();
+  if (as_int(acc) > instr->imm) // !(x <= k)
+    ip = vm->ops + instr->operand;
+  POP(acc);
+  DISPATCH();
+
+ OP_AVM_BranchIfNeImm:
+  CHECK_POP("AVM_BranchIfNeImm", 1);
+  if (!is_int(acc)) {
+    FAIL("AVM_BranchIfNeImm: Expected an integer value.");
+  }
+ OP_AVM_BranchIfNeImm_unchecked:
+  // eqi k; bf L
+  DEBUG_MESSAGE();
+  if (as_int(acc) != instr->imm) // !(x == k)
+    ip = vm->ops + instr->operand;
+  POP(acc);
+  DISPATCH();
+
  OP_AVM_Halt: {
-    AVM_value_t res = apop(vm->astack);
-    return res;
+    SAVE();
+    return acc;
   }
 }
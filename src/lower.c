@@ -0,0 +1,96 @@
+#include "lower.h"
+#include "debug.h"
+#include <stdlib.h>
+
+static int32_t operand_of(AVM_instr_t *instr) {
+  switch (instr->kind) {
+  case AVM_Ldi:
+  case AVM_AddImm:
+  case AVM_SubImm:
+  case AVM_LeImm:
+  case AVM_EqImm:
+    return instr->const_int;
+  case AVM_Ldb:
+    return instr->const_bool;
+  case AVM_Access:
+  case AVM_MarkAcc:
+  case AVM_AccApply:
+  case AVM_AccTailApply:
+    return instr->access;
+  case AVM_AccSubImm:
+  case AVM_ApplyN:
+  case AVM_TailApplyN:
+    return instr->const_int;
+  case AVM_AccApplyN:
+  case AVM_AccTailApplyN:
+    return instr->access;
+  case AVM_Closure:
+  case AVM_FlatClosure:
+  case AVM_StaticClosure:
+  case AVM_CallDirect:
+  case AVM_TailCallDirect:
+  case AVM_SelfTailCall:
+  case AVM_Jump:
+  case AVM_CJump:
+  case AVM_AccAccLeBf:
+  case AVM_BranchIfGt:
+  case AVM_BranchIfNe:
+  case AVM_BranchIfGtImm:
+  case AVM_BranchIfNeImm:
+    return instr->addr;
+  default:
+    return 0;
+  }
+}
+
+AVM_op_t *lower_code(AVM_code_t *code) {
+  AVM_op_t *ops = malloc(sizeof(AVM_op_t) * (code->instr_size + 1));
+  if (ops == NULL)
+    error("lower_code: Couldn't allocate %d instructions.", code->instr_size + 1);
+
+  for (int i = 0; i < code->instr_size; ++i) {
+    ops[i].handler = NULL;
+    ops[i].kind = code->instr[i].kind;
+    ops[i].flags = 0;
+    ops[i].operand = operand_of(&code->instr[i]);
+    ops[i].index[0] = 0;
+    ops[i].index[1] = 0;
+    switch (code->instr[i].kind) {
+    case AVM_AccAccLeBf:
+      ops[i].index[1] = code->instr[i].access2;
+      /* fall through */
+    case AVM_AccSubImm:
+      ops[i].index[0] = code->instr[i].access;
+      break;
+    case AVM_BranchIfGtImm:
+    case AVM_BranchIfNeImm:
+      ops[i].imm = code->instr[i].const_int;
+      break;
+    case AVM_FlatClosure:
+    case AVM_AccApplyN:
+    case AVM_AccTailApplyN:
+    case AVM_CallDirect:
+    case AVM_TailCallDirect:
+    case AVM_SelfTailCall:
+      ops[i].index[0] = code->instr[i].const_int;
+      break;
+    case AVM_Grab:
+      ops[i].operand = i > 0 && code->instr[i - 1].kind == AVM_Grab
+        ? ops[i - 1].operand + 1 : 0;
+      break;
+    default:
+      break;
+    }
+  }
+  ops[code->instr_size] = (AVM_op_t){ .handler = NULL, .kind = AVM_Halt };
+
+  return ops;
+}
+
+void thread_code(AVM_op_t *ops, int size, void *const *table,
+                 void *const *unchecked_table) {
+  for (int i = 0; i < size; ++i)
+    ops[i].handler = (ops[i].flags & AVM_OP_UNCHECKED)
+      ? unchecked_table[ops[i].kind]
+      : table[ops[i].kind];
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "code.h"
+
+/* Lowers `code` into the packed form executed by `run()`. The result
+   has `code->instr_size + 1` entries: a `halt` is appended so that
+   returning to the end of the code stops the machine. */
+AVM_op_t *lower_code(AVM_code_t *code);
+
+/* Stores the handler of each instruction in `ops[0..size)`; `table`
+   maps instruction kinds to the labels of `run()`, and
+   `unchecked_table` to the labels that skip the runtime checks, used
+   for instructions flagged `AVM_OP_UNCHECKED`. */
+void thread_code(AVM_op_t *ops, int size, void *const *table,
+                 void *const *unchecked_table);
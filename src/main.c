@@ -1,23 +1,88 @@
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "code.h"
 #include "avm_parser.h"
 #include "runtime.h"
 #include "vm.h"
 #include "interp.h"
+#include "debug.h"
+#include "verify.h"
 
 #define MAX_INPUT_SIZE 8192
 
 int read_file(char *buf, size_t size, FILE *fp);
 
+/* Prints how many application sites of the optimized code there are
+   and how many of them call a known closure directly. */
+static void print_stats(AVM_VM *vm) {
+  int sites = 0, direct = 0, regions = 0;
+  for (int pc = 0; pc < vm->code->instr_size; ++pc) {
+    if (vm->ops[pc].flags & AVM_OP_REGION)
+      ++regions;
+    switch (vm->code->instr[pc].kind) {
+    case AVM_CallDirect:
+    case AVM_TailCallDirect:
+    case AVM_SelfTailCall:
+      ++direct;
+      /* fall through */
+    case AVM_Apply:
+    case AVM_TailApply:
+    case AVM_AccApply:
+    case AVM_AccTailApply:
+    case AVM_ApplyN:
+    case AVM_TailApplyN:
+    case AVM_AccApplyN:
+    case AVM_AccTailApplyN:
+      ++sites;
+      break;
+    default:
+      break;
+    }
+  }
+  printf("Call sites: %d, direct: %d\n", sites, direct);
+  printf("Region closures: %d\n", regions);
+  printf("Collections: %zu minor, %zu major\n", vm->minor_gcs, vm->major_gcs);
+  printf("Longest pause: %.3f ms\n", vm->max_pause / 1e6);
+}
+
+static int usage(char *name) {
+  fprintf(stderr, "Usage: %s [--disasm] [--stats] [--pause-target=<us>] <filename>?\n", name);
+  return 1;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc > 2) {
-    fprintf(stderr, "Usage: %s <filename>?\n", argv[0]);
-    return 1;
+  /* --disasm: print the optimized code instead of running it.
+     --stats: print statistics on the optimized code after the result
+     or the code.
+     --pause-target=<us>: mark incrementally, in steps of about <us>
+     microseconds. */
+  _Bool disasm = false, stats = false;
+  uint64_t pause_target = 0;
+  char *name = argv[0];
+  while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+    if (strcmp(argv[1], "--disasm") == 0) {
+      disasm = true;
+    } else if (strcmp(argv[1], "--stats") == 0) {
+      stats = true;
+    } else if (strncmp(argv[1], "--pause-target=", 15) == 0) {
+      char *end;
+      pause_target = strtoull(argv[1] + 15, &end, 10) * 1000;
+      if (*end != '\0' || pause_target == 0)
+        return usage(name);
+    } else {
+      return usage(name);
+    }
+    --argc;
+    ++argv;
   }
 
+  if (argc > 2)
+    return usage(name);
+
   FILE *fp;
 
   if (argc == 1) {
@@ -51,22 +116,30 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  AVM_instr_t *new_instr = realloc(code->instr, (code->instr_size + 10) * sizeof(AVM_instr_t));
-  if (new_instr == NULL) {
-    fprintf(stderr, "Failed to reallocate instructions.\n");
-    return 1;
-  }
+  AVM_VM *vm = init_vm(code, true);
+  vm->pause_target = pause_target;
 
-  code->instr = new_instr;
-  code->instr[code->instr_size] = HALT();
+  if (disasm) {
+    if (!vm->verified) {
+      AVM_verify_error *e = last_verify_error();
+      printf("; not verified at %03d: %s\n", e->pc, e->message);
+    }
+    disassemble_code(vm->code, vm->verified ? vm->frames : NULL);
+    if (stats)
+      print_stats(vm);
+    finalize_vm(vm);
+    return 0;
+  }
 
-  AVM_VM *vm = init_vm(code, true);
   AVM_value_t res = run(vm);
 
   printf("Result: ");
   print_value(res);
   printf("\n");
 
+  if (stats)
+    print_stats(vm);
+
   finalize_vm(vm);
 
   return 0;
@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #define GC_HEAP_GROW_FACTOR 8
 
@@ -24,22 +26,243 @@ void *reallocate(struct AVM_VM *vm, void *ptr, size_t old_size, size_t new_size)
   return tmp;
 }
 
-void *allocate_object(struct AVM_VM *vm, size_t size, AVM_object_kind kind) {
+static void collect(struct AVM_VM *vm, size_t bytes);
 
-#ifdef DEBUG_GC_TEST
-  run_gc(vm);
+/* The space of an object of `size` bytes bumped in the nursery or in
+   the region, header included. */
+static size_t bump_bytes(size_t size) {
+  return (sizeof(AVM_object_t) + size + 7) & ~(size_t)7;
+}
+
+
+/* Slabs */
+
+static int slab_class(size_t bytes) {
+  return bytes <= 32 ? 0 : (int)((bytes - 32 + 15) / 16);
+}
+
+static AVM_page_t *page_of(AVM_object_t *header) {
+  return (AVM_page_t*)((uintptr_t)header & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+/* The first slot of a page, past its header. */
+static char *page_slots(AVM_page_t *page) {
+  return (char*)page + ((sizeof(AVM_page_t) + 15) & ~(size_t)15);
+}
+
+static size_t page_slot_count(AVM_page_t *page) {
+  return ((char*)page + SLAB_PAGE_SIZE - page_slots(page)) / page->slot_bytes;
+}
+
+/* The bit of a slot in the marks of its page: that of its first 16
+   bytes. */
+static size_t mark_bit(AVM_page_t *page, AVM_object_t *header) {
+  return (size_t)((char*)header - (char*)page) / 16;
+}
+
+static _Bool page_marked(AVM_page_t *page, AVM_object_t *header) {
+  size_t bit = mark_bit(page, header);
+  return (page->marks[bit / 64] >> (bit % 64)) & 1;
+}
+
+/* Marks the object of `header`, in the bitmap of its page if it is in
+   one, and tells whether it was marked already. */
+static _Bool test_and_mark(AVM_object_t *header) {
+  if (!header->in_page) {
+    _Bool marked = header->is_marked;
+    header->is_marked = true;
+    return marked;
+  }
+  AVM_page_t *page = page_of(header);
+  size_t bit = mark_bit(page, header);
+  uint64_t mask = (uint64_t)1 << (bit % 64);
+  if (page->marks[bit / 64] & mask)
+    return true;
+  page->marks[bit / 64] |= mask;
+  return false;
+}
+
+static void push_free_slot(struct AVM_VM *vm, int c, AVM_object_t *slot) {
+  slot->kind = AVM_ObjFree;
+  slot->in_page = true;
+  slot->is_marked = false;
+  slot->next = vm->free_slots[c];
+  vm->free_slots[c] = slot;
+}
+
+static void new_page(struct AVM_VM *vm, int c) {
+  AVM_page_t *page = vm->spare_pages;
+  if (page != NULL) {
+    vm->spare_pages = page->next;
+    --vm->spare_count;
+  } else {
+    page = aligned_alloc(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+    if (page == NULL)
+      error("new_page: Couldn't allocate a slab page.");
+  }
+  page->slot_bytes = 32 + 16 * c;
+  /* Marking may be under way, and a spare page still has the marks
+     it was released with, a fresh one whatever `aligned_alloc` left. */
+  memset(page->marks, 0, sizeof(page->marks));
+  page->next = vm->pages[c];
+  vm->pages[c] = page;
+
+  /* Thread the slots so that the first one is popped first. */
+  for (size_t i = page_slot_count(page); i > 0; --i)
+    push_free_slot(vm, c, (AVM_object_t*)(page_slots(page) + (i - 1) * page->slot_bytes));
+}
+
+#if DEBUG_GC_LOG_LEVEL >= 2
+static void log_free(AVM_object_t *header);
 #endif
 
-  if (vm->allocated_bytes > vm->next_gc)
-    run_gc(vm);
+/* Sweeps the next page of class `c` the last major collection left
+   unswept, threading its unmarked slots on the free list. */
+static void sweep_page(struct AVM_VM *vm, int c) {
+  AVM_page_t *page = vm->unswept[c];
+  vm->unswept[c] = page->next;
+  page->next = vm->pages[c];
+  vm->pages[c] = page;
+
+  for (size_t i = page_slot_count(page); i > 0; --i) {
+    AVM_object_t *slot = (AVM_object_t*)(page_slots(page) + (i - 1) * page->slot_bytes);
+    if (page_marked(page, slot))
+      continue;
+#if DEBUG_GC_LOG_LEVEL >= 2
+    if (slot->kind != AVM_ObjFree)
+      log_free(slot);
+#endif
+    push_free_slot(vm, c, slot);
+  }
+}
+
+static AVM_object_t *slab_alloc(struct AVM_VM *vm, size_t bytes) {
+  int c = slab_class(bytes);
+  /* The marks of a page are only complete once marking is done. */
+  while (vm->free_slots[c] == NULL && vm->unswept[c] != NULL && !vm->marking)
+    sweep_page(vm, c);
+  if (vm->free_slots[c] == NULL)
+    new_page(vm, c);
+  AVM_object_t *slot = vm->free_slots[c];
+  vm->free_slots[c] = slot->next;
+  vm->allocated_bytes += 32 + 16 * c;
+  vm->slab_bytes += 32 + 16 * c;
+  return slot;
+}
+
+static void clear_marks(struct AVM_VM *vm) {
+  for (int c = 0; c < SLAB_CLASSES; ++c) {
+    for (AVM_page_t *page = vm->pages[c]; page != NULL; page = page->next)
+      memset(page->marks, 0, sizeof(page->marks));
+    for (AVM_page_t *page = vm->unswept[c]; page != NULL; page = page->next)
+      memset(page->marks, 0, sizeof(page->marks));
+  }
+}
+
+/* Leaves every page to be swept again, once marked: the free slots are
+   threaded anew as the pages are. */
+static void unsweep_pages(struct AVM_VM *vm) {
+  for (int c = 0; c < SLAB_CLASSES; ++c) {
+    if (vm->pages[c] != NULL) {
+      AVM_page_t *last = vm->pages[c];
+      while (last->next != NULL)
+        last = last->next;
+      last->next = vm->unswept[c];
+      vm->unswept[c] = vm->pages[c];
+      vm->pages[c] = NULL;
+    }
+    vm->free_slots[c] = NULL;
+  }
+}
+
+/* Counts the marked slots of each page once marking is done, and
+   releases the pages with none; the others are swept as their class
+   needs slots. Up to as many as those in use, or the minimum heap,
+   are kept spare, so that a heap growing back does not fault them in
+   again. */
+static void release_pages(struct AVM_VM *vm) {
+  size_t used = 0;
+  size_t live_bytes = 0;
+  for (int c = 0; c < SLAB_CLASSES; ++c) {
+    AVM_page_t **link = &vm->unswept[c];
+    while (*link != NULL) {
+      AVM_page_t *page = *link;
+      size_t live = 0;
+      for (size_t i = 0; i < sizeof(page->marks) / sizeof(page->marks[0]); ++i)
+        live += __builtin_popcountll(page->marks[i]);
+      if (live == 0) {
+        *link = page->next;
+        page->next = vm->spare_pages;
+        vm->spare_pages = page;
+        ++vm->spare_count;
+      } else {
+        link = &page->next;
+        live_bytes += live * page->slot_bytes;
+        ++used;
+      }
+    }
+  }
+  vm->allocated_bytes = vm->allocated_bytes - vm->slab_bytes + live_bytes;
+  vm->slab_bytes = live_bytes;
+
+  /* Giving pages back to libc may have it trim its heap, which takes
+     milliseconds: an incremental collection keeps them all. */
+  if (vm->pause_target != 0)
+    return;
+
+  size_t min_pages = (MIN_HEAP_SIZE) / SLAB_PAGE_SIZE;
+  size_t keep = used > min_pages ? used : min_pages;
+  while (vm->spare_count > keep) {
+    AVM_page_t *page = vm->spare_pages;
+    vm->spare_pages = page->next;
+    --vm->spare_count;
+    free(page);
+  }
+}
+
+static void free_pages(AVM_page_t **pages) {
+  while (*pages != NULL) {
+    AVM_page_t *page = *pages;
+    *pages = page->next;
+    free(page);
+  }
+}
+
+void free_slabs(struct AVM_VM *vm) {
+  for (int c = 0; c < SLAB_CLASSES; ++c) {
+    free_pages(&vm->pages[c]);
+    free_pages(&vm->unswept[c]);
+    vm->free_slots[c] = NULL;
+  }
+  free_pages(&vm->spare_pages);
+  vm->spare_count = 0;
+  vm->slab_bytes = 0;
+}
 
+/* Allocates an object in the old generation without collecting
+   first: in a slab slot, or with `reallocate` and linked in
+   `vm->objs` when it is larger. */
+static void *link_object(struct AVM_VM *vm, size_t size, AVM_object_kind kind) {
   size_t new_size = sizeof(AVM_object_t) + size;
 
-  AVM_object_t *header = reallocate(vm, NULL, 0, new_size);
+  AVM_object_t *header;
+  if (new_size <= SLAB_MAX_BYTES) {
+    header = slab_alloc(vm, new_size);
+  } else {
+    header = reallocate(vm, NULL, 0, new_size);
+    header->in_page = false;
+    header->next = vm->objs;
+    vm->objs = header;
+  }
   header->kind = kind;
-  header->next = vm->objs;
   header->is_marked = false;
-  vm->objs = header;
+  /* The write barrier of incremental marking. Objects never change
+     once built, so the only references stored in the old generation
+     while marking are those of the objects promoted or born there;
+     being marked, these keep whatever they refer to, which was
+     reachable when marking began or is as new, from being swept. */
+  if (vm->marking)
+    test_and_mark(header);
 
 #if DEBUG_GC_LOG_LEVEL >= 2
   printf("%zu bytes allocated at %p for type %d\n", new_size, (void*)header, kind);
@@ -48,6 +271,35 @@ void *allocate_object(struct AVM_VM *vm, size_t size, AVM_object_kind kind) {
 
 }
 
+void *allocate_object(struct AVM_VM *vm, size_t size, AVM_object_kind kind) {
+
+#ifdef DEBUG_GC_TEST
+  run_gc(vm);
+#endif
+
+  size_t bytes = bump_bytes(size);
+  if (bytes > NURSERY_SIZE / 8) {
+    if (vm->marking || vm->allocated_bytes > vm->next_gc)
+      collect(vm, 0);
+    /* Its fields are stored after this, and may be young. */
+    AVM_object_t *header = (AVM_object_t*)link_object(vm, size, kind) - 1;
+    if (!push_array(vm->remembered, header))
+      error("allocate_object: Couldn't remember an old object.");
+    return (void *)(header + 1);
+  }
+
+  if (vm->nursery_top + bytes > vm->nursery_limit)
+    collect(vm, bytes);
+
+  AVM_object_t *header = (AVM_object_t*)(vm->nursery + vm->nursery_top);
+  header->kind = kind;
+  header->is_marked = false;
+  header->in_page = false;
+  header->next = NULL;    /* the copy, once promoted */
+  vm->nursery_top += bytes;
+  return (void *)(header + 1);
+}
+
 inline AVM_value_t new_int(struct AVM_VM *vm, int i) {
   (void)vm;
   return mk_int(i);
@@ -58,106 +310,347 @@ inline AVM_value_t new_bool(struct AVM_VM *vm, _Bool b) {
   return mk_bool(b);
 }
 
-AVM_value_t new_clos(struct AVM_VM *vm, int l, array_t *penv) {
+AVM_value_t new_clos(struct AVM_VM *vm, int l, AVM_penv_t *penv, uint32_t live) {
+  /* A minor collection would move `penv`. */
+  vm->held_penv = penv;
   AVM_clos_t *clos = allocate_object(vm, sizeof(AVM_clos_t), AVM_ObjClos);
+  penv = vm->held_penv;
+  vm->held_penv = NULL;
   clos->addr = l;
+  clos->live = live;
   clos->penv = penv;
   return mk_obj((AVM_object_t*)clos - 1);
 }
 
-array_t *new_penv(struct AVM_VM *vm) {
-  array_t *penv = allocate_object(vm, sizeof(array_t), AVM_ObjPEnv);
-  init_array(penv, ARRAY_MINIMAL_CAP);
+static size_t penv_bytes(size_t n) {
+  return sizeof(AVM_penv_t) + sizeof(AVM_value_t) * n;
+}
+
+AVM_penv_t *new_penv(struct AVM_VM *vm, AVM_penv_t *parent, uint32_t parent_live,
+                     AVM_value_t *values, size_t n) {
+  vm->held_penv = parent;
+  AVM_penv_t *penv = allocate_object(vm, penv_bytes(n), AVM_ObjPEnv);
+  parent = vm->held_penv;
+  vm->held_penv = NULL;
+  penv->parent = parent;
+  penv->parent_live = parent_live;
+  penv->size = n;
+  penv->base = penv_size(parent, parent_live);
+  memcpy(penv->values, values, sizeof(AVM_value_t) * n);
   return penv;
 }
 
+AVM_value_t new_flat_clos(struct AVM_VM *vm, int l, AVM_value_t *values, size_t n) {
+  if (n == 0)
+    return new_clos(vm, l, NULL, 0);
+
+  return new_clos(vm, l, new_penv(vm, NULL, 0, values, n), n);
+}
+
+AVM_value_t new_static_clos(int l) {
+  AVM_object_t *header = malloc(sizeof(AVM_object_t) + sizeof(AVM_clos_t));
+  if (header == NULL)
+    error("new_static_clos: Couldn't allocate a closure.");
+  header->kind = AVM_ObjClos;
+  header->is_marked = true;
+  header->in_page = false;
+  header->next = NULL;
+
+  AVM_clos_t *clos = (AVM_clos_t*)(header + 1);
+  clos->addr = l;
+  clos->live = 0;
+  clos->penv = NULL;
+  return mk_obj(header);
+}
+
+void free_static_clos(AVM_value_t clos) {
+  free(as_obj(clos));
+}
+
+static size_t pap_bytes(size_t n) {
+  return sizeof(AVM_pap_t) + sizeof(AVM_value_t) * n;
+}
+
+AVM_value_t new_pap(struct AVM_VM *vm, AVM_value_t *frame, size_t n) {
+  AVM_pap_t *pap = allocate_object(vm, pap_bytes(n), AVM_ObjPap);
+  pap->clos = frame[0];
+  pap->size = n;
+  for (size_t i = 0; i < n; ++i)
+    pap->args[i] = frame[1 + 2 * i];
+  return mk_obj((AVM_object_t*)pap - 1);
+}
+
+static size_t object_bytes(AVM_object_t *header) {
+  switch (header->kind) {
+  case AVM_ObjClos:
+    return sizeof(AVM_clos_t);
+  case AVM_ObjPEnv:
+    return penv_bytes(((AVM_penv_t*)(header + 1))->size);
+  case AVM_ObjPap:
+    return pap_bytes(((AVM_pap_t*)(header + 1))->size);
+  case AVM_ObjFree:
+    break;
+  }
+  return 0;
+}
+
+
+/* Region */
+
+/* Bumps the region by an object of `size` bytes, which must fit. */
+static void *region_object(struct AVM_VM *vm, size_t size, AVM_object_kind kind) {
+  AVM_object_t *header = (AVM_object_t*)(vm->region + vm->region_top);
+  header->kind = kind;
+  header->is_marked = true;
+  header->in_page = false;
+  header->next = NULL;
+  vm->region_top += bump_bytes(size);
+  return (void *)(header + 1);
+}
+
+AVM_value_t new_region_clos(struct AVM_VM *vm, int l, AVM_penv_t *penv, uint32_t live) {
+  if (vm->region_top + bump_bytes(sizeof(AVM_clos_t)) > REGION_SIZE)
+    return new_clos(vm, l, penv, live);
+
+  AVM_clos_t *clos = region_object(vm, sizeof(AVM_clos_t), AVM_ObjClos);
+  clos->addr = l;
+  clos->live = live;
+  clos->penv = penv;
+  return mk_obj((AVM_object_t*)clos - 1);
+}
+
+AVM_value_t new_region_flat_clos(struct AVM_VM *vm, int l, AVM_value_t *values, size_t n) {
+  if (n == 0 || vm->region_top + bump_bytes(penv_bytes(n)) +
+      bump_bytes(sizeof(AVM_clos_t)) > REGION_SIZE)
+    return new_flat_clos(vm, l, values, n);
+
+  AVM_penv_t *penv = region_object(vm, penv_bytes(n), AVM_ObjPEnv);
+  penv->parent = NULL;
+  penv->parent_live = 0;
+  penv->size = n;
+  penv->base = 0;
+  memcpy(penv->values, values, sizeof(AVM_value_t) * n);
+
+  AVM_clos_t *clos = region_object(vm, sizeof(AVM_clos_t), AVM_ObjClos);
+  clos->addr = l;
+  clos->live = n;
+  clos->penv = penv;
+  return mk_obj((AVM_object_t*)clos - 1);
+}
+
 
 /* GC */
 
-void free_object(struct AVM_VM *vm, AVM_object_t* header) {
 #if DEBUG_GC_LOG_LEVEL >= 2
+static void log_free(AVM_object_t *header) {
   printf("free_object: %p\n  contents: ", (void*)header);
   switch (header->kind) {
   case AVM_ObjClos:
     print_clos((AVM_clos_t*)(header + 1));
     break;
   case AVM_ObjPEnv:
-    print_penv((array_t*)(header + 1));
+    print_penv((AVM_penv_t*)(header + 1), ((AVM_penv_t*)(header + 1))->size);
+    break;
+  case AVM_ObjPap:
+    print_pap((AVM_pap_t*)(header + 1));
+    break;
+  case AVM_ObjFree:
     break;
   }
   printf("\n");
+}
 #endif
 
-  if (header->kind == AVM_ObjPEnv) {
-    array_t *penv = (array_t*)(header + 1);
-    free(penv->data);
-  }
+void free_object(struct AVM_VM *vm, AVM_object_t* header) {
+#if DEBUG_GC_LOG_LEVEL >= 2
+  log_free(header);
+#endif
 
-  reallocate(vm, header,
-             sizeof(AVM_object_t) +
-             (header->kind == AVM_ObjClos ? sizeof(AVM_clos_t) : sizeof(array_t)),
-             0);
+  reallocate(vm, header, sizeof(AVM_object_t) + object_bytes(header), 0);
 
   return;
 }
 
-static void mark_penv(struct AVM_VM *vm, array_t *penv);
-
-static void mark_value(struct AVM_VM *vm, AVM_value_t val) {
-  if (!is_obj(val))
-    return;
-
-  AVM_object_t *header = as_obj(val);
-
-  if (header->is_marked)
+/* Marks the object of `header` and pushes it on the gray stack, for
+   `drain_gray` to mark what it refers to. If the stack is full, it is
+   left marked but unscanned, and `vm->gray_overflow` tells `mark` to
+   find it again. */
+static void mark_object(struct AVM_VM *vm, AVM_object_t *header) {
+  if (test_and_mark(header))
     return;
 
 #if DEBUG_GC_LOG_LEVEL >= 2
-  printf("mark_value: %p\n", (void*)header);
+  printf("mark_object: %p\n", (void*)header);
 #endif
+  if (array_size(vm->gray) >= vm->gray_limit || !push_array(vm->gray, header))
+    vm->gray_overflow = true;
+}
 
-  header->is_marked = true;
+static void mark_value(struct AVM_VM *vm, AVM_value_t val) {
+  if (is_obj(val))
+    mark_object(vm, as_obj(val));
+}
 
-  if (header->kind == AVM_ObjClos)
-    mark_penv(vm, ((AVM_clos_t*)(header + 1))->penv);
+static void mark_penv(struct AVM_VM *vm, AVM_penv_t *penv) {
+  if (penv != NULL)
+    mark_object(vm, (AVM_object_t*)penv - 1);
+}
+
+/* How many values ahead the headers of a frame's or a PAP's values are
+   prefetched while they are marked. */
+#define MARK_PREFETCH_DISTANCE 8
+
+static void mark_values(struct AVM_VM *vm, AVM_value_t *values, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    if (i + MARK_PREFETCH_DISTANCE < n && is_obj(values[i + MARK_PREFETCH_DISTANCE]))
+      __builtin_prefetch(as_obj(values[i + MARK_PREFETCH_DISTANCE]), 1);
+    mark_value(vm, values[i]);
+  }
 }
 
-static void mark_penv(struct AVM_VM *vm, array_t *penv) {
-  AVM_object_t *header = (AVM_object_t*)penv - 1;
+/* A gray entry is a header, or, with its lowest bit set, that of a
+   frame or a PAP whose values are left to mark from the index pushed
+   below it: these are marked `MARK_SLICE` at a time, which keeps a
+   step of incremental marking short. */
+#define MARK_SLICE 256
 
-  if (header->is_marked)
+static void push_slice(struct AVM_VM *vm, AVM_object_t *header, size_t from) {
+  if (array_size(vm->gray) + 2 > vm->gray_limit
+      || !push_array(vm->gray, (void*)from)) {
+    vm->gray_overflow = true;
     return;
+  }
+  if (!push_array(vm->gray, (void*)((uintptr_t)header | 1))) {
+    pop_array_n(vm->gray, 1);
+    vm->gray_overflow = true;
+  }
+}
 
-  header->is_marked = true;
+/* Marks `values[from..n)` of the object of `header`, up to a slice of
+   them, and returns how many. */
+static size_t mark_slice(struct AVM_VM *vm, AVM_object_t *header,
+                         AVM_value_t *values, size_t from, size_t n) {
+  size_t end = n - from > MARK_SLICE ? from + MARK_SLICE : n;
+  if (end < n)
+    push_slice(vm, header, end);
+  mark_values(vm, values + from, end - from);
+  return end - from;
+}
 
-#if DEBUG_GC_LOG_LEVEL >= 2
-  printf("mark_penv: %p\n", (void*)header);
-#endif
+/* Marks what the object of `header` refers to, from its value `from`
+   on, and returns how many references that was. The values a view
+   has dropped are marked as well; they are freed with the frame. */
+static size_t scan_object(struct AVM_VM *vm, AVM_object_t *header, size_t from) {
+  switch (header->kind) {
+  case AVM_ObjClos:
+    mark_penv(vm, ((AVM_clos_t*)(header + 1))->penv);
+    return 1;
+  case AVM_ObjPEnv: {
+    AVM_penv_t *penv = (AVM_penv_t*)(header + 1);
+    if (from == 0)
+      mark_penv(vm, penv->parent);
+    return 1 + mark_slice(vm, header, penv->values, from, penv->size);
+  }
+  case AVM_ObjPap: {
+    AVM_pap_t *pap = (AVM_pap_t*)(header + 1);
+    if (from == 0)
+      mark_value(vm, pap->clos);
+    return 1 + mark_slice(vm, header, pap->args, from, pap->size);
+  }
+  case AVM_ObjFree:
+    break;
+  }
+  return 0;
+}
 
-  for (size_t i = 0; i < array_size(penv); ++i) {
-    mark_value(vm, (AVM_value_t)array_elem_unsafe(penv, i));
+/* Pops a gray entry and scans it. */
+static size_t scan_gray(struct AVM_VM *vm) {
+  uintptr_t entry = (uintptr_t)array_last(vm->gray);
+  pop_array_n(vm->gray, 1);
+  size_t from = 0;
+  if (entry & 1) {
+    from = (size_t)array_last(vm->gray);
+    pop_array_n(vm->gray, 1);
+    entry &= ~(uintptr_t)1;
   }
+  return scan_object(vm, (AVM_object_t*)entry, from);
 }
 
+static void drain_gray(struct AVM_VM *vm) {
+  while (array_size(vm->gray) > 0)
+    scan_gray(vm);
+}
+
+/* Traces what the live region objects refer to. Being marked, they
+   are never pushed by `mark_object` themselves. */
+static void mark_region(struct AVM_VM *vm) {
+  size_t top = 0;
+  while (top < vm->region_top) {
+    AVM_object_t *header = (AVM_object_t*)(vm->region + top);
+    scan_object(vm, header, 0);
+    top += bump_bytes(object_bytes(header));
+  }
+}
 
-static void mark(struct AVM_VM *vm) {
+static void rescan_pages(struct AVM_VM *vm, AVM_page_t *page) {
+  for (; page != NULL; page = page->next) {
+    for (size_t i = 0; i < page_slot_count(page); ++i) {
+      AVM_object_t *header = (AVM_object_t*)(page_slots(page) + i * page->slot_bytes);
+      if (page_marked(page, header)) {
+        scan_object(vm, header, 0);
+        drain_gray(vm);
+      }
+    }
+  }
+}
+
+/* Scans every marked object again, until the gray stack no longer
+   overflows: those it could not take are marked, but what they refer
+   to may not be. The region objects are born marked, and never
+   pushed. */
+static void rescan_marked(struct AVM_VM *vm) {
+  while (vm->gray_overflow) {
+#if DEBUG_GC_LOG_LEVEL >= 1
+    printf("-- gray stack overflow: rescanning\n");
+#endif
+    vm->gray_overflow = false;
+    for (AVM_object_t *header = vm->objs; header != NULL; header = header->next) {
+      if (header->is_marked) {
+        scan_object(vm, header, 0);
+        drain_gray(vm);
+      }
+    }
+    for (int c = 0; c < SLAB_CLASSES; ++c) {
+      rescan_pages(vm, vm->pages[c]);
+      rescan_pages(vm, vm->unswept[c]);
+    }
+  }
+}
+
+/* Marks the roots gray, the nursery being empty. */
+static void mark_roots(struct AVM_VM *vm) {
   size_t i;
+  // Mark vm->acc
+  mark_value(vm, vm->acc);
   // Mark vm->astack
   for (i = 0; i < array_size(vm->astack); ++i) {
     mark_value(vm, (AVM_value_t)(uintptr_t)array_elem_unsafe(vm->astack, i));
   }
   // mark vm->rstack
-  for (i = 0; i < array_size(vm->rstack); ++i) {
-    AVM_ret_frame_t *f = array_elem_unsafe(vm->rstack, i);
-    mark_penv(vm, f->penv);
+  for (i = 0; i < vm->rstack->size; ++i) {
+    mark_penv(vm, vm->rstack->data[i].penv);
   }
   // mark vm->env
   for (i = 0; i < array_size(vm->env->cache); ++i) {
     mark_value(vm, (AVM_value_t)(uintptr_t)array_elem_unsafe(vm->env->cache, i));
   }
   mark_penv(vm, vm->env->penv);
+  mark_penv(vm, vm->held_penv);
+  mark_region(vm);
 }
 
+/* Sweeps `vm->objs`, the objects too large for slab slots; the pages
+   are swept as they are allocated from, by `sweep_page`. */
 static void sweep(struct AVM_VM *vm) {
   AVM_object_t *prev, *cur;
   prev = NULL;
@@ -184,17 +677,131 @@ static void sweep(struct AVM_VM *vm) {
   }
 }
 
-void run_gc(struct AVM_VM *vm) {
-  if (vm->env == NULL)
-    return;
+/* Minor collection: the young objects reachable from the roots, the
+   region and the remembered objects are copied to the old generation,
+   leaving their copy in `next`, and the pointers to them are updated.
+   The nursery is then empty again. */
+
+static _Bool is_young(struct AVM_VM *vm, AVM_object_t *header) {
+  return (char*)header >= vm->nursery && (char*)header < vm->nursery + NURSERY_SIZE;
+}
+
+static AVM_object_t *promote(struct AVM_VM *vm, AVM_object_t *header) {
+  if (header->next != NULL)
+    return header->next;
+
+  size_t size = object_bytes(header);
+  AVM_object_t *copy = (AVM_object_t*)link_object(vm, size, header->kind) - 1;
+  memcpy(copy + 1, header + 1, size);
+  header->next = copy;
+  if (!push_array(vm->promoted, copy))
+    error("minor_gc: Couldn't push a promoted object.");
+  return copy;
+}
+
+static AVM_value_t forward_value(struct AVM_VM *vm, AVM_value_t val) {
+  if (is_obj(val) && is_young(vm, as_obj(val)))
+    return mk_obj(promote(vm, as_obj(val)));
+  return val;
+}
+
+static AVM_penv_t *forward_penv(struct AVM_VM *vm, AVM_penv_t *penv) {
+  if (penv != NULL && is_young(vm, (AVM_object_t*)penv - 1))
+    return (AVM_penv_t*)(promote(vm, (AVM_object_t*)penv - 1) + 1);
+  return penv;
+}
+
+static void forward_fields(struct AVM_VM *vm, AVM_object_t *header) {
+  switch (header->kind) {
+  case AVM_ObjClos: {
+    AVM_clos_t *clos = (AVM_clos_t*)(header + 1);
+    clos->penv = forward_penv(vm, clos->penv);
+    break;
+  }
+  case AVM_ObjPEnv: {
+    AVM_penv_t *penv = (AVM_penv_t*)(header + 1);
+    penv->parent = forward_penv(vm, penv->parent);
+    for (size_t i = 0; i < penv->size; ++i)
+      penv->values[i] = forward_value(vm, penv->values[i]);
+    break;
+  }
+  case AVM_ObjPap: {
+    AVM_pap_t *pap = (AVM_pap_t*)(header + 1);
+    pap->clos = forward_value(vm, pap->clos);
+    for (uint32_t i = 0; i < pap->size; ++i)
+      pap->args[i] = forward_value(vm, pap->args[i]);
+    break;
+  }
+  case AVM_ObjFree:
+    break;
+  }
+}
 
+static void forward_array(struct AVM_VM *vm, array_t *array) {
+  size_t size = array_size(array);
+  for (size_t i = 0; i < size; ++i)
+    array->data[i] = (void*)(uintptr_t)
+      forward_value(vm, (AVM_value_t)(uintptr_t)array_elem_unsafe(array, i));
+}
+
+static void minor_gc(struct AVM_VM *vm) {
 #if DEBUG_GC_LOG_LEVEL >= 1
-  printf("-- gc begin\n");
-  size_t before = vm->allocated_bytes;
+  printf("-- minor gc: %zu young bytes\n", vm->nursery_top);
 #endif
 
-  mark(vm);
+  vm->acc = forward_value(vm, vm->acc);
+  forward_array(vm, vm->astack);
+  for (size_t i = 0; i < vm->rstack->size; ++i)
+    vm->rstack->data[i].penv = forward_penv(vm, vm->rstack->data[i].penv);
+  if (vm->env != NULL) {
+    forward_array(vm, vm->env->cache);
+    vm->env->penv = forward_penv(vm, vm->env->penv);
+  }
+  vm->held_penv = forward_penv(vm, vm->held_penv);
+  for (size_t top = 0; top < vm->region_top; ) {
+    AVM_object_t *header = (AVM_object_t*)(vm->region + top);
+    forward_fields(vm, header);
+    top += bump_bytes(object_bytes(header));
+  }
+  for (size_t i = 0; i < array_size(vm->remembered); ++i)
+    forward_fields(vm, array_elem_unsafe(vm->remembered, i));
+  clean_array(vm->remembered);
+
+  while (array_size(vm->promoted) > 0) {
+    AVM_object_t *header = array_last(vm->promoted);
+    pop_array_n(vm->promoted, 1);
+    forward_fields(vm, header);
+  }
+
+  vm->nursery_top = 0;
+  ++vm->minor_gcs;
+}
+
+/* Major collection: marks from the roots and sweeps the old
+   generation, which holds every object once the nursery is empty.
+   Closures, frames and PAPs never change once built, so what was
+   reachable when marking began stays reachable from the roots marked
+   then: marking may go on in steps between allocations (see
+   `mark_step`), and nothing marks the roots again at the end. */
+static void begin_marking(struct AVM_VM *vm) {
+#if DEBUG_GC_LOG_LEVEL >= 1
+  printf("-- gc begin: %zu bytes\n", vm->allocated_bytes);
+#endif
+
+  clear_marks(vm);
+  vm->marking = true;
+  mark_roots(vm);
+}
+
+static void finish_marking(struct AVM_VM *vm) {
+  drain_gray(vm);
+  rescan_marked(vm);
+  vm->marking = false;
+  vm->nursery_limit = NURSERY_SIZE;
+
   sweep(vm);
+  unsweep_pages(vm);
+  release_pages(vm);
 
   size_t next_gc_candidate = vm->allocated_bytes * GC_HEAP_GROW_FACTOR;
   if (next_gc_candidate < MIN_HEAP_SIZE)
@@ -203,11 +810,85 @@ void run_gc(struct AVM_VM *vm) {
     next_gc_candidate = MAX_HEAP_SIZE;
 
   vm->next_gc = next_gc_candidate;
+  ++vm->major_gcs;
 
 #if DEBUG_GC_LOG_LEVEL >= 1
-  printf("-- gc end\n");
-  printf("   collected %zu bytes (from %zu to %zu) next at %zu\n",
-         before - vm->allocated_bytes, before, vm->allocated_bytes,
-         vm->next_gc);
+  printf("-- gc end: %zu bytes, next at %zu\n", vm->allocated_bytes, vm->next_gc);
 #endif
 }
+
+static void major_gc(struct AVM_VM *vm) {
+  if (vm->env == NULL)
+    return;
+
+  begin_marking(vm);
+  finish_marking(vm);
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Scans gray objects, following at most `vm->mark_budget` references
+   and for about `vm->pause_target` nanoseconds since `start`, and
+   finishes the major collection once none is left. */
+static void mark_step(struct AVM_VM *vm, uint64_t start) {
+  size_t work = 0, timed = 0;
+  while (array_size(vm->gray) > 0) {
+    if (work >= vm->mark_budget)
+      return;
+    if (work - timed >= MARK_SLICE) {
+      timed = work;
+      if (now_ns() - start >= vm->pause_target)
+        return;
+    }
+    work += scan_gray(vm);
+  }
+  finish_marking(vm);
+}
+
+/* Makes room for an object of `bytes` in the nursery, or of none for
+   one born old: a minor collection if the nursery cannot take it, and
+   a major one past the threshold. A major collection only begins
+   here when it is incremental; each call makes a step of it then,
+   the next one coming `GC_STEP_BYTES` later. */
+static void collect(struct AVM_VM *vm, size_t bytes) {
+  uint64_t start = now_ns();
+
+  if (vm->nursery_top + bytes > NURSERY_SIZE)
+    minor_gc(vm);
+  if (vm->marking) {
+    /* Marking does not keep up: the heap is not to grow on forever. */
+    if (vm->allocated_bytes > 2 * vm->next_gc)
+      finish_marking(vm);
+    else
+      mark_step(vm, start);
+  } else if (vm->allocated_bytes > vm->next_gc) {
+    if (vm->nursery_top > 0)
+      minor_gc(vm);
+    if (vm->pause_target == 0)
+      major_gc(vm);
+    else
+      begin_marking(vm);
+  }
+  if (vm->marking && vm->nursery_top + bytes + GC_STEP_BYTES < NURSERY_SIZE)
+    vm->nursery_limit = vm->nursery_top + bytes + GC_STEP_BYTES;
+  else
+    vm->nursery_limit = NURSERY_SIZE;
+
+  uint64_t pause = now_ns() - start;
+  if (pause > vm->max_pause)
+    vm->max_pause = pause;
+}
+
+void run_gc(struct AVM_VM *vm) {
+  if (vm->env == NULL)
+    return;
+
+  minor_gc(vm);
+  if (vm->marking)
+    finish_marking(vm);
+  major_gc(vm);
+}
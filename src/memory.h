@@ -16,6 +16,8 @@ void *reallocate(struct AVM_VM *vm, void *ptr, size_t old_size, size_t new_size)
 typedef enum {
   AVM_ObjClos,
   AVM_ObjPEnv,
+  AVM_ObjPap,
+  AVM_ObjFree,    /* a free slot of a slab page, never a value */
 } AVM_object_kind;
 
 typedef struct AVM_object AVM_object_t;
@@ -23,16 +25,50 @@ typedef struct AVM_object AVM_object_t;
 struct AVM_object {
   AVM_object_kind kind;
   _Bool is_marked;
+  /* A slot of a slab page, marked in the page's bitmap rather than by
+     `is_marked`. */
+  _Bool in_page;
   AVM_object_t *next;
 };
 
+/* Allocates an object in the nursery, or in the old generation when it
+   is large; either may collect first, moving the young objects, so the
+   caller must not hold pointers to objects outside the roots. */
 void *allocate_object(struct AVM_VM *vm, size_t size, AVM_object_kind kind);
 
 AVM_value_t new_int(struct AVM_VM *vm, int i);
 AVM_value_t new_bool(struct AVM_VM *vm, _Bool b);
-AVM_value_t new_clos(struct AVM_VM *vm, int l, array_t *penv);
-array_t *new_penv(struct AVM_VM *vm);
+AVM_value_t new_clos(struct AVM_VM *vm, int l, AVM_penv_t *penv, uint32_t live);
+/* A frame of `values[0..n)`, the head last, on top of the first
+   `parent_live` values of `parent`. The values are stored in the
+   object itself; they must be reachable by the GC (e.g. on the
+   stack or in the environment cache). */
+AVM_penv_t *new_penv(struct AVM_VM *vm, AVM_penv_t *parent, uint32_t parent_live,
+                     AVM_value_t *values, size_t n);
+/* A closure whose environment holds only `values[0..n)`, the head
+   last. `values` must be reachable by the GC (e.g. on the stack). */
+AVM_value_t new_flat_clos(struct AVM_VM *vm, int l, AVM_value_t *values, size_t n);
+/* An immortal closure of `l` with the empty environment. It is not
+   linked into `vm->objs` and is born marked, so the GC never traces
+   into it nor sweeps it; `free_static_clos` releases it. */
+AVM_value_t new_static_clos(int l);
+/* The partial application of the closure `frame[0]` to the `n`
+   arguments its leading `grab`s have bound in `frame`: `frame[1]`,
+   `frame[3]`, ... `frame` must be reachable by the GC. */
+AVM_value_t new_pap(struct AVM_VM *vm, AVM_value_t *frame, size_t n);
+void free_static_clos(AVM_value_t clos);
+/* `new_clos` and `new_flat_clos` in the region of the running frame
+   (see `AVM_VM`), which its end frees at once. Region objects are not
+   linked into `vm->objs` and are born marked; the GC only traces what
+   the live ones refer to. When the region is full, these fall back to
+   the heap. */
+AVM_value_t new_region_clos(struct AVM_VM *vm, int l, AVM_penv_t *penv, uint32_t live);
+AVM_value_t new_region_flat_clos(struct AVM_VM *vm, int l, AVM_value_t *values, size_t n);
 
+/* Frees an object of `vm->objs`, one too large for a slab slot. */
 void free_object(struct AVM_VM *vm, AVM_object_t* header);
+/* Releases the slab pages, and the objects left in them. */
+void free_slabs(struct AVM_VM *vm);
 
+/* A full collection: a minor one, then a major one. */
 void run_gc(struct AVM_VM *vm);
@@ -0,0 +1,450 @@
+#include "optimize.h"
+#include "closure.h"
+#include "debug.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The optimizer first flattens the closures (src/closure.c), then
+   rewrites the code in three passes, counting the arguments of the
+   applications before the last one. Each pass replaces short
+   sequences by shorter ones, provided that none of the replaced
+   instructions but the first is the target of a jump, a closure, or a
+   return (i.e. the instruction after an `app` or a `grab`).
+
+   Immediates
+
+   A constant pushed only to be consumed by the next operator becomes
+   the operator's operand. `add` and `eq` commute, so a constant pushed
+   below an `acc` is folded as well.
+
+     load k; add             =>  AddImm k
+     load k; sub             =>  SubImm k
+     load k; le              =>  LeImm k
+     load k; eq              =>  EqImm k
+     load k; acc n; add      =>  acc n; AddImm k
+     load k; acc n; eq       =>  acc n; EqImm k
+
+   Branches
+
+   `bf` consumes the boolean computed just before it, so a comparison
+   followed by a `bf` branches on the integers directly. The boolean is
+   never materialized; the rewrite is skipped when the `bf` is a target,
+   since the boolean may then come from elsewhere.
+
+     le; bf L                =>  BranchIfGt L
+     eq; bf L                =>  BranchIfNe L
+     LeImm k; bf L           =>  BranchIfGtImm k L
+     EqImm k; bf L           =>  BranchIfNeImm k L
+
+   Arguments
+
+   An application whose arguments were all pushed since its mark, or
+   since the function was entered for a tail call, binds them at once:
+   `enter` skips as many leading `grab`s of the callee as it can (see
+   src/interp.c). `n` counts the function's arguments, and the pass
+   only follows straight-line code, forgetting what it counted at every
+   target and every instruction it does not model. `n` is a hint: the
+   values bound are those the `grab`s would have, up to the first mark.
+
+     app                     =>  ApplyN n        when 2 <= n <= 255
+     tapp                    =>  TailApplyN n    when 2 <= n <= 255
+
+   Superinstructions
+
+   The sequences below dominate the benchmarks in docs/performance.md.
+
+     acc n; acc m; BranchIfGt L  =>  AccAccLeBf n m L
+     acc n; SubImm k             =>  AccSubImm n k
+     acc k; app                  =>  AccApply k
+     acc k; tapp                 =>  AccTailApply k
+     acc k; ApplyN n             =>  AccApplyN k n
+     acc k; TailApplyN n         =>  AccTailApplyN k n
+     mark; acc n                 =>  MarkAcc n
+
+   Direct calls
+
+   A closure pushed only to be applied is known: with nothing captured,
+   it is the static closure of its label, which the call enters without
+   pushing, decoding or checking it. `n` is 1 for `app` and `tapp`.
+   `init_vm` resolves the `AccApply`s of static closures the same way,
+   from the types the verifier proves (see src/verify.c).
+
+     clos.static L; app          =>  CallDirect L 1
+     clos.static L; tapp         =>  TailCallDirect L 1
+     clos.static L; ApplyN n     =>  CallDirect L n
+     clos.static L; TailApplyN n =>  TailCallDirect L n
+*/
+
+static _Bool is_index(int n) {
+  return 0 <= n && n <= AVM_OP_INDEX_MAX;
+}
+
+static _Bool has_target(AVM_instr_t *instr) {
+  switch (instr->kind) {
+  case AVM_Jump:
+  case AVM_CJump:
+  case AVM_Closure:
+  case AVM_FlatClosure:
+  case AVM_StaticClosure:
+  case AVM_CallDirect:
+  case AVM_TailCallDirect:
+  case AVM_AccAccLeBf:
+  case AVM_BranchIfGt:
+  case AVM_BranchIfNe:
+  case AVM_BranchIfGtImm:
+  case AVM_BranchIfNeImm:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* Marks every address control may enter other than by falling through. */
+static _Bool *find_targets(AVM_code_t *code) {
+  _Bool *targets = calloc(code->instr_size + 1, sizeof(_Bool));
+  if (targets == NULL)
+    error("optimize_code: Couldn't allocate the target table.");
+
+  for (int i = 0; i < code->instr_size; ++i) {
+    AVM_instr_t *instr = &code->instr[i];
+    if (has_target(instr) && 0 <= instr->addr && instr->addr <= code->instr_size)
+      targets[instr->addr] = true;
+    if (instr->kind == AVM_Apply || instr->kind == AVM_ApplyN ||
+        instr->kind == AVM_CallDirect || instr->kind == AVM_Grab)
+      targets[i + 1] = true;
+  }
+
+  return targets;
+}
+
+/* Whether the `n` instructions starting at `i` can only be entered from
+   the first one. */
+static _Bool interior_free(_Bool *targets, int i, int n) {
+  for (int k = 1; k < n; ++k)
+    if (targets[i + k])
+      return false;
+  return true;
+}
+
+static _Bool kind_at(AVM_code_t *code, int i, AVM_instr_kind kind) {
+  return i < code->instr_size && code->instr[i].kind == kind;
+}
+
+static AVM_instr_kind immediate_of(AVM_instr_kind kind) {
+  switch (kind) {
+  case AVM_Add: return AVM_AddImm;
+  case AVM_Sub: return AVM_SubImm;
+  case AVM_Le:  return AVM_LeImm;
+  case AVM_Eq:  return AVM_EqImm;
+  default:      return kind;
+  }
+}
+
+/* A rewrite replaces the instructions starting at `i` by the ones it
+   stores to `out`, sets `*produced` to their number, and returns the
+   number of instructions consumed; 0 means no rewrite. */
+typedef int (*rewrite_t)(AVM_code_t *code, _Bool *targets, int i,
+                         AVM_instr_t *out, int *produced);
+
+static int immediate_at(AVM_code_t *code, _Bool *targets, int i,
+                        AVM_instr_t *out, int *produced) {
+  AVM_instr_t *in = code->instr + i;
+
+  if (!kind_at(code, i, AVM_Ldi))
+    return 0;
+
+  if (i + 1 < code->instr_size && immediate_of(in[1].kind) != in[1].kind &&
+      interior_free(targets, i, 2)) {
+    out[0] = (AVM_instr_t){ .kind = immediate_of(in[1].kind),
+                            .const_int = in[0].const_int };
+    *produced = 1;
+    return 2;
+  }
+
+  if (kind_at(code, i + 1, AVM_Access) &&
+      (kind_at(code, i + 2, AVM_Add) || kind_at(code, i + 2, AVM_Eq)) &&
+      interior_free(targets, i, 3)) {
+    out[0] = in[1];
+    out[1] = (AVM_instr_t){ .kind = immediate_of(in[2].kind),
+                            .const_int = in[0].const_int };
+    *produced = 2;
+    return 3;
+  }
+
+  return 0;
+}
+
+static _Bool is_imm(int n) {
+  return AVM_OP_IMM_MIN <= n && n <= AVM_OP_IMM_MAX;
+}
+
+static int branch_at(AVM_code_t *code, _Bool *targets, int i,
+                     AVM_instr_t *out, int *produced) {
+  AVM_instr_t *in = code->instr + i;
+  *produced = 1;
+
+  if (!kind_at(code, i + 1, AVM_CJump) || !interior_free(targets, i, 2))
+    return 0;
+
+  switch (in[0].kind) {
+  case AVM_Le:
+    *out = (AVM_instr_t){ .kind = AVM_BranchIfGt, .addr = in[1].addr };
+    return 2;
+  case AVM_Eq:
+    *out = (AVM_instr_t){ .kind = AVM_BranchIfNe, .addr = in[1].addr };
+    return 2;
+  case AVM_LeImm:
+  case AVM_EqImm:
+    if (!is_imm(in[0].const_int))
+      return 0;
+    *out = (AVM_instr_t){
+      .kind = in[0].kind == AVM_LeImm ? AVM_BranchIfGtImm : AVM_BranchIfNeImm,
+      .const_int = in[0].const_int, .addr = in[1].addr };
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+/* How many values `instr` pushes minus how many it pops, or INT_MIN
+   if it is not straight-line code the counting models. */
+static int stack_effect(AVM_instr_t *instr) {
+  switch (instr->kind) {
+  case AVM_Ldi:
+  case AVM_Ldb:
+  case AVM_Access:
+  case AVM_Closure:
+  case AVM_StaticClosure:
+    return 1;
+  case AVM_FlatClosure:
+    return 1 - instr->const_int;
+  case AVM_AddImm:
+  case AVM_SubImm:
+  case AVM_LeImm:
+  case AVM_EqImm:
+  case AVM_EndLet:
+    return 0;
+  case AVM_Add:
+  case AVM_Sub:
+  case AVM_Le:
+  case AVM_Eq:
+  case AVM_Let:
+  case AVM_CJump:
+  case AVM_BranchIfGtImm:
+  case AVM_BranchIfNeImm:
+    return -1;
+  case AVM_BranchIfGt:
+  case AVM_BranchIfNe:
+    return -2;
+  default:
+    return INT_MIN;
+  }
+}
+
+/* Rewrites `app` and `tapp` to their n-ary forms in place, counting
+   the values pushed since the innermost open mark (`counts[depth]`),
+   or since the last jump or closure target when no mark is open. An
+   application pops the function, its arguments and their mark, and
+   pushes its result; control returns after it with the same counts,
+   so return points need not reset them. */
+static void count_arguments(AVM_code_t *code) {
+  _Bool *targets = calloc(code->instr_size + 1, sizeof(_Bool));
+  int *counts = malloc(sizeof(int) * (code->instr_size + 1));
+  if (targets == NULL || counts == NULL)
+    error("optimize_code: Couldn't allocate the argument counts.");
+
+  for (int i = 0; i < code->instr_size; ++i) {
+    AVM_instr_t *instr = &code->instr[i];
+    if (has_target(instr) && 0 <= instr->addr && instr->addr <= code->instr_size)
+      targets[instr->addr] = true;
+  }
+
+  int depth = 0;
+  counts[0] = 0;
+  for (int i = 0; i < code->instr_size; ++i) {
+    AVM_instr_t *instr = &code->instr[i];
+    if (targets[i]) {
+      depth = 0;
+      counts[0] = 0;
+    }
+
+    switch (instr->kind) {
+    case AVM_PushMark:
+      ++counts[depth];
+      counts[++depth] = 0;
+      break;
+    case AVM_Apply:
+    case AVM_TailApply: {
+      _Bool tail = instr->kind == AVM_TailApply;
+      if (counts[depth] >= 3 && is_index(counts[depth] - 1)) {
+        instr->const_int = counts[depth] - 1;
+        instr->kind = tail ? AVM_TailApplyN : AVM_ApplyN;
+      }
+      if (!tail && depth > 0) {
+        --depth;
+      } else {
+        depth = 0;
+        counts[0] = 0;
+      }
+      break;
+    }
+    default: {
+      int effect = stack_effect(instr);
+      if (effect == INT_MIN || counts[depth] + effect < 0) {
+        depth = 0;
+        counts[0] = 0;
+      } else {
+        counts[depth] += effect;
+      }
+      break;
+    }
+    }
+  }
+
+  free(targets);
+  free(counts);
+}
+
+/* Fuses the instructions starting at `i` into a single one. */
+static int fuse_at(AVM_code_t *code, _Bool *targets, int i,
+                   AVM_instr_t *out, int *produced) {
+  AVM_instr_t *in = code->instr + i;
+  *produced = 1;
+
+  /* The instructions after the first must only be entered from it. */
+#define INTERIOR_FREE(n) interior_free(targets, i, (n))
+
+  if (kind_at(code, i, AVM_Access) && kind_at(code, i + 1, AVM_Access) &&
+      kind_at(code, i + 2, AVM_BranchIfGt) &&
+      is_index(in[0].access) && is_index(in[1].access) && INTERIOR_FREE(3)) {
+    *out = (AVM_instr_t){ .kind = AVM_AccAccLeBf, .access = in[0].access,
+                          .access2 = in[1].access, .addr = in[2].addr };
+    return 3;
+  }
+
+  if (kind_at(code, i, AVM_Access) && kind_at(code, i + 1, AVM_SubImm) &&
+      is_index(in[0].access) && INTERIOR_FREE(2)) {
+    *out = (AVM_instr_t){ .kind = AVM_AccSubImm, .access = in[0].access,
+                          .const_int = in[1].const_int };
+    return 2;
+  }
+
+  if (kind_at(code, i, AVM_Access) && kind_at(code, i + 1, AVM_Apply) && INTERIOR_FREE(2)) {
+    *out = (AVM_instr_t){ .kind = AVM_AccApply, .access = in[0].access };
+    return 2;
+  }
+
+  if (kind_at(code, i, AVM_Access) && kind_at(code, i + 1, AVM_TailApply) && INTERIOR_FREE(2)) {
+    *out = (AVM_instr_t){ .kind = AVM_AccTailApply, .access = in[0].access };
+    return 2;
+  }
+
+  if (kind_at(code, i, AVM_Access) && kind_at(code, i + 1, AVM_ApplyN) &&
+      INTERIOR_FREE(2)) {
+    *out = (AVM_instr_t){ .kind = AVM_AccApplyN, .access = in[0].access,
+                          .const_int = in[1].const_int };
+    return 2;
+  }
+
+  if (kind_at(code, i, AVM_Access) && kind_at(code, i + 1, AVM_TailApplyN) &&
+      INTERIOR_FREE(2)) {
+    *out = (AVM_instr_t){ .kind = AVM_AccTailApplyN, .access = in[0].access,
+                          .const_int = in[1].const_int };
+    return 2;
+  }
+
+  if (kind_at(code, i, AVM_StaticClosure) && i + 1 < code->instr_size &&
+      INTERIOR_FREE(2)) {
+    switch (in[1].kind) {
+    case AVM_Apply:
+    case AVM_ApplyN:
+      *out = (AVM_instr_t){ .kind = AVM_CallDirect, .addr = in[0].addr,
+                            .const_int = in[1].kind == AVM_Apply ? 1 : in[1].const_int };
+      return 2;
+    case AVM_TailApply:
+    case AVM_TailApplyN:
+      *out = (AVM_instr_t){ .kind = AVM_TailCallDirect, .addr = in[0].addr,
+                            .const_int = in[1].kind == AVM_TailApply ? 1 : in[1].const_int };
+      return 2;
+    default:
+      break;
+    }
+  }
+
+  /* Leave the `acc` to a longer sequence if it starts one. */
+  AVM_instr_t ignored;
+  int ignored_size;
+  if (kind_at(code, i, AVM_PushMark) && kind_at(code, i + 1, AVM_Access) &&
+      !targets[i + 1] && fuse_at(code, targets, i + 1, &ignored, &ignored_size) == 0) {
+    *out = (AVM_instr_t){ .kind = AVM_MarkAcc, .access = in[1].access };
+    return 2;
+  }
+
+#undef INTERIOR_FREE
+  return 0;
+}
+
+/* Applies `rewrite` at every instruction from left to right and
+   retargets the addresses to the rewritten code. */
+static AVM_code_t *rewrite_code(AVM_code_t *code, rewrite_t rewrite) {
+  int n = code->instr_size;
+  _Bool *targets = find_targets(code);
+  int *map = malloc(sizeof(int) * (n + 1));
+  AVM_instr_t *instrs = malloc(sizeof(AVM_instr_t) * (n > 0 ? n : 1));
+  AVM_code_t *res = malloc(sizeof(AVM_code_t));
+  if (map == NULL || instrs == NULL || res == NULL)
+    error("optimize_code: Couldn't allocate the optimized code.");
+
+  int size = 0;
+  for (int i = 0; i < n;) {
+    int produced = 1;
+    int consumed = rewrite(code, targets, i, &instrs[size], &produced);
+    if (consumed == 0) {
+      instrs[size] = code->instr[i];
+      consumed = 1;
+      produced = 1;
+    }
+    for (int k = 0; k < consumed; ++k)
+      map[i + k] = size;
+    size += produced;
+    i += consumed;
+  }
+  map[n] = size;
+
+  /* Retarget jumps and closures. */
+  for (int i = 0; i < size; ++i) {
+    AVM_instr_t *instr = &instrs[i];
+    if (has_target(instr) && 0 <= instr->addr && instr->addr <= n)
+      instr->addr = map[instr->addr];
+  }
+
+  free(targets);
+  free(map);
+
+  res->instr = instrs;
+  res->instr_size = size;
+  return res;
+}
+
+/* Rewrites `res` with `rewrite`, freeing it unless it is the source
+   `code`. */
+static AVM_code_t *run_pass(AVM_code_t *code, AVM_code_t *res, rewrite_t rewrite) {
+  AVM_code_t *next = rewrite_code(res, rewrite);
+  if (res != code) {
+    free(res->instr);
+    free(res);
+  }
+  return next;
+}
+
+AVM_code_t *optimize_code(AVM_code_t *code) {
+  AVM_code_t *res = flatten_closures(code);
+
+  res = run_pass(code, res, immediate_at);
+  res = run_pass(code, res, branch_at);
+  /* `res` is a copy by now, so it can be rewritten in place. */
+  count_arguments(res);
+  res = run_pass(code, res, fuse_at);
+  return res;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "code.h"
+
+/* Returns an optimized copy of `code`; both the result and its `instr`
+   are allocated from heap. Jump and closure addresses are retargeted
+   to the new instruction indices, and address `code->instr_size` (the
+   end of the code) is mapped to the end of the copy. */
+AVM_code_t *optimize_code(AVM_code_t *code);
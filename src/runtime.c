@@ -10,7 +10,7 @@
 
 // TODO: Add better error handling
 void print_astack(AVM_astack_t *st);
-void print_rstack(AVM_astack_t *st);
+void print_rstack(AVM_rstack_t *st);
 void print_ret_frame(AVM_ret_frame_t *f);
 void print_env(AVM_env_t *env);
 
@@ -53,46 +53,39 @@ _Bool apush(AVM_astack_t* stp, AVM_value_t val) {
 }
 
 AVM_rstack_t* init_rstack() {
-  return make_array(ARRAY_MINIMAL_CAP);
+  AVM_rstack_t *stack = malloc(sizeof(AVM_rstack_t));
+  if (stack == NULL)
+    error("init_rstack: Couldn't allocate the return stack.");
+  stack->data = malloc(sizeof(AVM_ret_frame_t) * ARRAY_MINIMAL_CAP);
+  if (stack->data == NULL)
+    error("init_rstack: Couldn't allocate the return stack.");
+  stack->size = 0;
+  stack->capacity = ARRAY_MINIMAL_CAP;
+  return stack;
 }
 
 void drop_rstack(AVM_rstack_t* stack) {
-  drop_array(stack);
+  free(stack->data);
+  free(stack);
 }
 
-AVM_ret_frame_t* rpop(AVM_rstack_t* stp) {
-  AVM_ret_frame_t* f = array_last(stp);
-  int count = pop_array(stp);
-  if (count == 0) return NULL;
-
-#ifdef DEBUG_TRACE_EXECUTION
-  printf("Popped from rstack:\n  ");
-  print_ret_frame(f);
-  printf(" <- ");
-  print_rstack(stp);
-  printf("\n");
-#endif
-
-  return f;
-}
-
-_Bool rpush(AVM_rstack_t* stp, AVM_ret_frame_t *frame) {
-#ifdef DEBUG_TRACE_EXECUTION
-  printf("Pushed to rstack:\n  ");
-  print_ret_frame(frame);
-  printf(" -> ");
-  print_rstack(stp);
-  printf("\n");
-#endif
-  int count = push_array(stp, frame);
-  return (count != 0);
+_Bool grow_rstack(AVM_rstack_t* stp) {
+  size_t capacity = ARRAY_BIGGER_CAP(stp->capacity);
+  AVM_ret_frame_t *data = realloc(stp->data, sizeof(AVM_ret_frame_t) * capacity);
+  if (data == NULL)
+    return false;
+  stp->data = data;
+  stp->capacity = capacity;
+  return true;
 }
 
 AVM_env_t* init_env(struct AVM_VM *vm) {
   AVM_env_t *new_env = malloc(sizeof(AVM_env_t));
   new_env->cache = make_array(ARRAY_MINIMAL_CAP);
-  new_env->penv = new_penv(vm);
+  new_env->penv = NULL;
+  new_env->live = 0;
   new_env->offset = 0;
+  (void)vm;
 
 /* #ifdef DEBUG_TRACE_EXECUTION */
 /*   printf("Env initialized:\n"); */
@@ -130,7 +123,9 @@ AVM_value_t lookup(AVM_env_t *env, size_t index) {
 #endif
     return res;
   } else {
-    AVM_value_t res = (AVM_value_t)(uintptr_t)array_elem(env->penv, env->penv->size - (index - GET_CURRENT_SIZE(env)) - 1);
+    if (index - GET_CURRENT_SIZE(env) >= penv_size(env->penv, env->live))
+      error("lookup: Unbound variable %zu.", index);
+    AVM_value_t res = penv_lookup(env->penv, env->live, index - GET_CURRENT_SIZE(env));
 #ifdef DEBUG_TRACE_EXECUTION
     printf("Found ");
     print_value(res);
@@ -142,30 +137,39 @@ AVM_value_t lookup(AVM_env_t *env, size_t index) {
   }
 }
 
+/* Freezes the bindings of the current frame into a new penv frame on
+   top of the current one. Only the frame is copied; the penv below is
+   shared. */
 void perpetuate(struct AVM_VM *vm, AVM_env_t *env) {
-  array_t *tmp = new_penv(vm);
-  if (push_array_all(tmp, env->penv) < 0)
-    error("perpetuate: Failed to copy the current penv.");
-  if (push_array_offset(tmp, env->cache, env->offset) == -1)
-    error("perpetuate: Failed to reserve the memory for a new environment.");
+  if (env->cache->size == env->offset)
+    return;
+  if (env->cache->size - env->offset > UINT32_MAX)
+    error("perpetuate: The frame has too many bindings.");
+
+  AVM_penv_t *tmp = new_penv(vm, env->penv, env->live,
+                             (AVM_value_t*)env->cache->data + env->offset,
+                             env->cache->size - env->offset);
 
   pop_array_n(env->cache, env->cache->size - env->offset);
   env->penv = tmp;
+  env->live = tmp->size;
 }
 
-void remove_head(struct AVM_VM *vm, AVM_env_t *env) {
+void remove_head(AVM_env_t *env) {
   // Case 1: cache is not empty
   if (env->cache->size > env->offset) {
     pop_array(env->cache);
     return;
   }
 
-  // Case 2: cache is empty
-  push_array_all(env->cache, env->penv);
-  if (pop_array(env->cache) == 0)
+  // Case 2: cache is empty; the head is the last live value of penv.
+  if (env->penv == NULL)
     error("remove_head: The environment is empty.");
 
-  env->penv = new_penv(vm);
+  if (--env->live == 0) {
+    env->live = env->penv->parent_live;
+    env->penv = env->penv->parent;
+  }
 }
 
 void print_value(AVM_value_t val) {
@@ -173,6 +177,8 @@ void print_value(AVM_value_t val) {
     printf("%d", as_int(val));
   } else if (is_bool(val)) {
     printf("%s", val == VAL_TRUE ? "true" : "false");
+  } else if (is_obj(val) && as_obj(val)->kind == AVM_ObjPap) {
+    print_pap((AVM_pap_t*)(as_obj(val) + 1));
   } else if (is_obj(val)) {
     print_clos((AVM_clos_t*)(as_obj(val) + 1));
   } else if (is_epsilon(val)) {
@@ -183,7 +189,17 @@ void print_value(AVM_value_t val) {
 }
 
 void print_clos(AVM_clos_t *clos) {
-  printf("<clos(%d, %p)>", clos->addr, clos->penv);
+  printf("<clos(%d, %p, %u)>", clos->addr, clos->penv, clos->live);
+}
+
+void print_pap(AVM_pap_t *pap) {
+  printf("<pap(");
+  print_value(pap->clos);
+  for (uint32_t i = 0; i < pap->size; ++i) {
+    printf(", ");
+    print_value(pap->args[i]);
+  }
+  printf(")>");
 }
 
 void print_astack(AVM_astack_t *st) {
@@ -196,18 +212,17 @@ void print_astack(AVM_astack_t *st) {
   printf(" ]");
 }
 
-void print_rstack(AVM_astack_t *st) {
+void print_rstack(AVM_rstack_t *st) {
   printf("[");
-  int size = array_size(st);
-  for (int i = 1; i <= size; ++i) {
+  for (size_t i = st->size; i > 0; i--) {
     printf(" ");
-    print_ret_frame(array_elem_unsafe(st, size - i));
+    print_ret_frame(&st->data[i - 1]);
   }
   printf(" ]");
 }
 
 void print_ret_frame(AVM_ret_frame_t *f) {
-  printf("(%d, %p, %zu)", f->addr, f->penv, f->offset);
+  printf("(%d, %p, %u, %zu, %zu)", f->addr, f->penv, f->live, f->offset, f->region);
 }
 
 void print_env(AVM_env_t *env) {
@@ -217,18 +232,23 @@ void print_env(AVM_env_t *env) {
     print_value((AVM_value_t)(uintptr_t)array_elem_unsafe(env->cache, i-1));
   }
   printf(" |");
-  for (size_t i = env->penv->size; i > 0; i--) {
-    printf(" ");
-    print_value((AVM_value_t)(uintptr_t)array_elem_unsafe(env->penv, i-1));
+  uint32_t live = env->live;
+  for (AVM_penv_t *p = env->penv; p != NULL; live = p->parent_live, p = p->parent) {
+    for (size_t i = live; i > 0; i--) {
+      printf(" ");
+      print_value(p->values[i-1]);
+    }
   }
   printf(" ]");
 }
 
-void print_penv(array_t *penv) {
+void print_penv(AVM_penv_t *penv, uint32_t live) {
   printf("[|");
-  for (size_t i = penv->size; i > 0; i--) {
-    printf(" ");
-    print_value((AVM_value_t)(uintptr_t)array_elem_unsafe(penv, i-1));
+  for (; penv != NULL; live = penv->parent_live, penv = penv->parent) {
+    for (size_t i = live; i > 0; i--) {
+      printf(" ");
+      print_value(penv->values[i-1]);
+    }
   }
   printf(" ]");
 }
@@ -5,21 +5,50 @@
 #include "array.h"
 
 typedef array_t AVM_astack_t;
-typedef array_t AVM_rstack_t;
+
+typedef uint64_t AVM_value_t;
+
+/* A frozen frame of the persistent environment. Frames never change
+   once captured, so closures share them and capturing does not copy
+   the bindings below.
+
+   A persistent environment is a frame together with how many of its
+   values are `live`: the first `live` values (the head last) followed
+   by the `parent_live` first ones of `parent`, and so on. Dropping the
+   head only decrements `live`, so it neither copies nor allocates.
+   NULL is the empty environment.
+
+   The values are laid out right after the frame, in the same GC
+   object, and there are exactly `size` of them. */
+typedef struct AVM_penv {
+  struct AVM_penv *parent;
+  uint32_t parent_live;
+  uint32_t size;    /* values in this frame */
+  size_t base;      /* bindings below this frame */
+  AVM_value_t values[];
+} AVM_penv_t;
 
 typedef struct {
-  array_t *penv;
+  AVM_penv_t *penv;
+  uint32_t live;    /* values of `penv` in scope */
   array_t *cache;
   size_t offset;
 } AVM_env_t;
 
 typedef struct {
   int addr;
-  array_t *penv;
+  uint32_t live;
+  AVM_penv_t *penv;
   size_t offset;
+  size_t region;    /* the caller's `region_base` */
 } AVM_ret_frame_t;
 
-typedef uint64_t AVM_value_t;
+/* The return stack holds the frames themselves, not pointers to them. */
+typedef struct {
+  AVM_ret_frame_t *data;
+  size_t size;
+  size_t capacity;
+} AVM_rstack_t;
 
 #define QNAN        ((uint64_t)0x7ffc000000000000)
 
@@ -30,10 +59,12 @@ typedef uint64_t AVM_value_t;
 #define TAG_INT     ((uint64_t)0x7ffd000000000000)
 #define TAG_MISC    ((uint64_t)0x7ffe000000000000)
 
+#define TAG_NONE    0
 #define TAG_EPSILON 1
 #define TAG_FALSE   2
 #define TAG_TRUE    3
 
+#define VAL_NONE    (TAG_MISC | TAG_NONE)
 #define VAL_EPSILON (TAG_MISC | TAG_EPSILON)
 #define VAL_FALSE   (TAG_MISC | TAG_FALSE)
 #define VAL_TRUE    (TAG_MISC | TAG_TRUE)
@@ -84,9 +115,34 @@ static inline _Bool as_bool(AVM_value_t v) {
 
 typedef struct {
   int addr;
-  array_t *penv;
+  uint32_t live;
+  AVM_penv_t *penv;
 } AVM_clos_t;
 
+/* A closure applied to fewer arguments than it grabs: `args[0]` is
+   the argument of the application, the others those of the `grab`s
+   run before `clos` returned this. */
+typedef struct {
+  AVM_value_t clos;
+  uint32_t size;
+  AVM_value_t args[];
+} AVM_pap_t;
+
+static inline size_t penv_size(AVM_penv_t *penv, uint32_t live) {
+  return penv == NULL ? 0 : penv->base + live;
+}
+
+/* The `index`-th binding of the first `live` values of `penv` from
+   its head, found as a (frame, slot) pair by skipping whole frames. */
+static inline AVM_value_t penv_lookup(AVM_penv_t *penv, uint32_t live, size_t index) {
+  while (index >= live) {
+    index -= live;
+    live = penv->parent_live;
+    penv = penv->parent;
+  }
+  return penv->values[live - index - 1];
+}
+
 AVM_astack_t* init_astack();
 void drop_astack(AVM_astack_t* stack);
 AVM_value_t apop(AVM_astack_t* stp);
@@ -94,8 +150,24 @@ _Bool apush(AVM_astack_t* stp, AVM_value_t val);
 
 AVM_rstack_t* init_rstack();
 void drop_rstack(AVM_rstack_t* stack);
-AVM_ret_frame_t* rpop(AVM_rstack_t* stp);
-_Bool rpush(AVM_rstack_t* stp, AVM_ret_frame_t *frame);
+/* Grows `stp` by `ARRAY_BIGGER_CAP`; false if it couldn't. */
+_Bool grow_rstack(AVM_rstack_t* stp);
+
+/* Copies `frame` on top of `stp`; false if the stack couldn't grow. */
+static inline _Bool rpush(AVM_rstack_t* stp, AVM_ret_frame_t frame) {
+  if (stp->size == stp->capacity && !grow_rstack(stp))
+    return false;
+  stp->data[stp->size++] = frame;
+  return true;
+}
+
+/* Pops the top frame, or returns NULL if `stp` is empty. The frame
+   stays valid until the next push. */
+static inline AVM_ret_frame_t* rpop(AVM_rstack_t* stp) {
+  if (stp->size == 0)
+    return NULL;
+  return &stp->data[--stp->size];
+}
 
 struct AVM_VM;
 
@@ -104,13 +176,14 @@ AVM_env_t* extend(AVM_env_t *env, AVM_value_t val);
 AVM_value_t lookup(AVM_env_t *env, size_t index);
 void perpetuate(struct AVM_VM *vm, AVM_env_t *env);
 
-// Removes the head of `env`.
-void remove_head(struct AVM_VM *vm, AVM_env_t *env);
+// Removes the head of `env`, without copying or allocating.
+void remove_head(AVM_env_t *env);
 
 void print_value(AVM_value_t val);
 void print_clos(AVM_clos_t *clos);
+void print_pap(AVM_pap_t *pap);
 void print_astack(AVM_astack_t *st);
-void print_rstack(AVM_astack_t *st);
+void print_rstack(AVM_rstack_t *st);
 void print_ret_frame(AVM_ret_frame_t *f);
 void print_env(AVM_env_t *env);
-void print_penv(array_t *env);
+void print_penv(AVM_penv_t *penv, uint32_t live);
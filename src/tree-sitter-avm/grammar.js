@@ -20,12 +20,17 @@ export default grammar({
 	  'let'  , 'endlet' , 'add'  , 'sub', 'le', 'eq'  , 'app' ,
 	  'tapp' , 'mark'   , 'grab' , 'ret' , 'halt'
       ),
-      cmd1: $ => field("cmd1", choice($.load, $.acc, $.b, $.bf, $.clos)),
+      cmd1: $ => field("cmd1", choice($.load, $.acc, $.b, $.bf, $.clos,
+                                      $.addi, $.subi, $.lei, $.eqi)),
       load: $ => seq('load', field("value", choice($.integer, $.bool))),
       acc: $ => seq('acc', field("index", $.nat)),
       b: $ => seq('b', field("addr", $.lab)),
       bf: $ => seq('bf', field("addr", $.lab)),
       clos: $ => seq('clos', field("addr", $.lab)),
+      addi: $ => seq('addi', field("value", $.integer)),
+      subi: $ => seq('subi', field("value", $.integer)),
+      lei: $ => seq('lei', field("value", $.integer)),
+      eqi: $ => seq('eqi', field("value", $.integer)),
       nat: $ => choice(/[1-9][0-9]*/, '0'),
       integer: $ => choice(/-?[1-9][0-9]*/, '0'),
       bool: $ => choice('true', 'false'),
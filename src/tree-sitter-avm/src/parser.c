@@ -7,11 +7,11 @@
 #endif
 
 #define LANGUAGE_VERSION 15
-#define STATE_COUNT 26
+#define STATE_COUNT 34
 #define LARGE_STATE_COUNT 5
-#define SYMBOL_COUNT 41
+#define SYMBOL_COUNT 49
 #define ALIAS_COUNT 0
-#define TOKEN_COUNT 26
+#define TOKEN_COUNT 30
 #define EXTERNAL_TOKEN_COUNT 0
 #define FIELD_COUNT 8
 #define MAX_ALIAS_SEQUENCE_LENGTH 3
@@ -38,28 +38,36 @@ enum ts_symbol_identifiers {
   anon_sym_b = 16,
   anon_sym_bf = 17,
   anon_sym_clos = 18,
-  aux_sym_nat_token1 = 19,
-  anon_sym_0 = 20,
-  aux_sym_integer_token1 = 21,
-  anon_sym_true = 22,
-  anon_sym_false = 23,
-  sym_lab = 24,
-  sym_comment = 25,
-  sym_source_file = 26,
-  sym_code = 27,
-  sym_block = 28,
-  sym_inst = 29,
-  sym_cmd0 = 30,
-  sym_cmd1 = 31,
-  sym_load = 32,
-  sym_acc = 33,
-  sym_b = 34,
-  sym_bf = 35,
-  sym_clos = 36,
-  sym_nat = 37,
-  sym_integer = 38,
-  sym_bool = 39,
-  aux_sym_code_repeat1 = 40,
+  anon_sym_addi = 19,
+  anon_sym_subi = 20,
+  anon_sym_lei = 21,
+  anon_sym_eqi = 22,
+  aux_sym_nat_token1 = 23,
+  anon_sym_0 = 24,
+  aux_sym_integer_token1 = 25,
+  anon_sym_true = 26,
+  anon_sym_false = 27,
+  sym_lab = 28,
+  sym_comment = 29,
+  sym_source_file = 30,
+  sym_code = 31,
+  sym_block = 32,
+  sym_inst = 33,
+  sym_cmd0 = 34,
+  sym_cmd1 = 35,
+  sym_load = 36,
+  sym_acc = 37,
+  sym_b = 38,
+  sym_bf = 39,
+  sym_clos = 40,
+  sym_addi = 41,
+  sym_subi = 42,
+  sym_lei = 43,
+  sym_eqi = 44,
+  sym_nat = 45,
+  sym_integer = 46,
+  sym_bool = 47,
+  aux_sym_code_repeat1 = 48,
 };
 
 static const char * const ts_symbol_names[] = {
@@ -82,6 +90,10 @@ static const char * const ts_symbol_names[] = {
   [anon_sym_b] = "b",
   [anon_sym_bf] = "bf",
   [anon_sym_clos] = "clos",
+  [anon_sym_addi] = "addi",
+  [anon_sym_subi] = "subi",
+  [anon_sym_lei] = "lei",
+  [anon_sym_eqi] = "eqi",
   [aux_sym_nat_token1] = "nat_token1",
   [anon_sym_0] = "0",
   [aux_sym_integer_token1] = "integer_token1",
@@ -100,6 +112,10 @@ static const char * const ts_symbol_names[] = {
   [sym_b] = "b",
   [sym_bf] = "bf",
   [sym_clos] = "clos",
+  [sym_addi] = "addi",
+  [sym_subi] = "subi",
+  [sym_lei] = "lei",
+  [sym_eqi] = "eqi",
   [sym_nat] = "nat",
   [sym_integer] = "integer",
   [sym_bool] = "bool",
@@ -126,6 +142,10 @@ static const TSSymbol ts_symbol_map[] = {
   [anon_sym_b] = anon_sym_b,
   [anon_sym_bf] = anon_sym_bf,
   [anon_sym_clos] = anon_sym_clos,
+  [anon_sym_addi] = anon_sym_addi,
+  [anon_sym_subi] = anon_sym_subi,
+  [anon_sym_lei] = anon_sym_lei,
+  [anon_sym_eqi] = anon_sym_eqi,
   [aux_sym_nat_token1] = aux_sym_nat_token1,
   [anon_sym_0] = anon_sym_0,
   [aux_sym_integer_token1] = aux_sym_integer_token1,
@@ -144,6 +164,10 @@ static const TSSymbol ts_symbol_map[] = {
   [sym_b] = sym_b,
   [sym_bf] = sym_bf,
   [sym_clos] = sym_clos,
+  [sym_addi] = sym_addi,
+  [sym_subi] = sym_subi,
+  [sym_lei] = sym_lei,
+  [sym_eqi] = sym_eqi,
   [sym_nat] = sym_nat,
   [sym_integer] = sym_integer,
   [sym_bool] = sym_bool,
@@ -227,6 +251,22 @@ static const TSSymbolMetadata ts_symbol_metadata[] = {
     .visible = true,
     .named = false,
   },
+  [anon_sym_addi] = {
+    .visible = true,
+    .named = false,
+  },
+  [anon_sym_subi] = {
+    .visible = true,
+    .named = false,
+  },
+  [anon_sym_lei] = {
+    .visible = true,
+    .named = false,
+  },
+  [anon_sym_eqi] = {
+    .visible = true,
+    .named = false,
+  },
   [aux_sym_nat_token1] = {
     .visible = false,
     .named = false,
@@ -299,6 +339,22 @@ static const TSSymbolMetadata ts_symbol_metadata[] = {
     .visible = true,
     .named = true,
   },
+  [sym_addi] = {
+    .visible = true,
+    .named = true,
+  },
+  [sym_subi] = {
+    .visible = true,
+    .named = true,
+  },
+  [sym_lei] = {
+    .visible = true,
+    .named = true,
+  },
+  [sym_eqi] = {
+    .visible = true,
+    .named = true,
+  },
   [sym_nat] = {
     .visible = true,
     .named = true,
@@ -406,6 +462,14 @@ static const TSStateId ts_primary_state_ids[STATE_COUNT] = {
   [23] = 23,
   [24] = 24,
   [25] = 25,
+  [26] = 26,
+  [27] = 27,
+  [28] = 28,
+  [29] = 29,
+  [30] = 30,
+  [31] = 31,
+  [32] = 32,
+  [33] = 33,
 };
 
 static bool ts_lex(TSLexer *lexer, TSStateId state) {
@@ -628,9 +692,11 @@ static bool ts_lex(TSLexer *lexer, TSStateId state) {
       END_STATE();
     case 49:
       ACCEPT_TOKEN(anon_sym_add);
+      if (lookahead == 'i') ADVANCE(117);
       END_STATE();
     case 50:
       ACCEPT_TOKEN(anon_sym_add);
+      if (lookahead == 'i') ADVANCE(118);
       if (('0' <= lookahead && lookahead <= '9') ||
           ('A' <= lookahead && lookahead <= 'Z') ||
           lookahead == '_' ||
@@ -638,9 +704,11 @@ static bool ts_lex(TSLexer *lexer, TSStateId state) {
       END_STATE();
     case 51:
       ACCEPT_TOKEN(anon_sym_sub);
+      if (lookahead == 'i') ADVANCE(119);
       END_STATE();
     case 52:
       ACCEPT_TOKEN(anon_sym_sub);
+      if (lookahead == 'i') ADVANCE(120);
       if (('0' <= lookahead && lookahead <= '9') ||
           ('A' <= lookahead && lookahead <= 'Z') ||
           lookahead == '_' ||
@@ -648,10 +716,12 @@ static bool ts_lex(TSLexer *lexer, TSStateId state) {
       END_STATE();
     case 53:
       ACCEPT_TOKEN(anon_sym_le);
+      if (lookahead == 'i') ADVANCE(121);
       if (lookahead == 't') ADVANCE(45);
       END_STATE();
     case 54:
       ACCEPT_TOKEN(anon_sym_le);
+      if (lookahead == 'i') ADVANCE(122);
       if (lookahead == 't') ADVANCE(46);
       if (('0' <= lookahead && lookahead <= '9') ||
           ('A' <= lookahead && lookahead <= 'Z') ||
@@ -660,9 +730,11 @@ static bool ts_lex(TSLexer *lexer, TSStateId state) {
       END_STATE();
     case 55:
       ACCEPT_TOKEN(anon_sym_eq);
+      if (lookahead == 'i') ADVANCE(123);
       END_STATE();
     case 56:
       ACCEPT_TOKEN(anon_sym_eq);
+      if (lookahead == 'i') ADVANCE(124);
       if (('0' <= lookahead && lookahead <= '9') ||
           ('A' <= lookahead && lookahead <= 'Z') ||
           lookahead == '_' ||
@@ -1061,6 +1133,46 @@ static bool ts_lex(TSLexer *lexer, TSStateId state) {
       if (lookahead != 0 &&
           lookahead != '\n') ADVANCE(116);
       END_STATE();
+    case 117:
+      ACCEPT_TOKEN(anon_sym_addi);
+      END_STATE();
+    case 118:
+      ACCEPT_TOKEN(anon_sym_addi);
+      if (('0' <= lookahead && lookahead <= '9') ||
+          ('A' <= lookahead && lookahead <= 'Z') ||
+          lookahead == '_' ||
+          ('a' <= lookahead && lookahead <= 'z')) ADVANCE(115);
+      END_STATE();
+    case 119:
+      ACCEPT_TOKEN(anon_sym_subi);
+      END_STATE();
+    case 120:
+      ACCEPT_TOKEN(anon_sym_subi);
+      if (('0' <= lookahead && lookahead <= '9') ||
+          ('A' <= lookahead && lookahead <= 'Z') ||
+          lookahead == '_' ||
+          ('a' <= lookahead && lookahead <= 'z')) ADVANCE(115);
+      END_STATE();
+    case 121:
+      ACCEPT_TOKEN(anon_sym_lei);
+      END_STATE();
+    case 122:
+      ACCEPT_TOKEN(anon_sym_lei);
+      if (('0' <= lookahead && lookahead <= '9') ||
+          ('A' <= lookahead && lookahead <= 'Z') ||
+          lookahead == '_' ||
+          ('a' <= lookahead && lookahead <= 'z')) ADVANCE(115);
+      END_STATE();
+    case 123:
+      ACCEPT_TOKEN(anon_sym_eqi);
+      END_STATE();
+    case 124:
+      ACCEPT_TOKEN(anon_sym_eqi);
+      if (('0' <= lookahead && lookahead <= '9') ||
+          ('A' <= lookahead && lookahead <= 'Z') ||
+          lookahead == '_' ||
+          ('a' <= lookahead && lookahead <= 'z')) ADVANCE(115);
+      END_STATE();
     default:
       return false;
   }
@@ -1093,6 +1205,14 @@ static const TSLexerMode ts_lex_modes[STATE_COUNT] = {
   [23] = {.lex_state = 0},
   [24] = {.lex_state = 0},
   [25] = {.lex_state = 2},
+  [26] = {.lex_state = 1},
+  [27] = {.lex_state = 1},
+  [28] = {.lex_state = 1},
+  [29] = {.lex_state = 1},
+  [30] = {.lex_state = 42},
+  [31] = {.lex_state = 42},
+  [32] = {.lex_state = 42},
+  [33] = {.lex_state = 42},
 };
 
 static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
@@ -1116,6 +1236,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [anon_sym_b] = ACTIONS(1),
     [anon_sym_bf] = ACTIONS(1),
     [anon_sym_clos] = ACTIONS(1),
+    [anon_sym_addi] = ACTIONS(1),
+    [anon_sym_subi] = ACTIONS(1),
+    [anon_sym_lei] = ACTIONS(1),
+    [anon_sym_eqi] = ACTIONS(1),
     [aux_sym_nat_token1] = ACTIONS(1),
     [anon_sym_0] = ACTIONS(1),
     [aux_sym_integer_token1] = ACTIONS(1),
@@ -1135,6 +1259,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [sym_b] = STATE(10),
     [sym_bf] = STATE(10),
     [sym_clos] = STATE(10),
+    [sym_addi] = STATE(10),
+    [sym_subi] = STATE(10),
+    [sym_lei] = STATE(10),
+    [sym_eqi] = STATE(10),
     [aux_sym_code_repeat1] = STATE(3),
     [anon_sym_let] = ACTIONS(5),
     [anon_sym_endlet] = ACTIONS(5),
@@ -1153,6 +1281,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [anon_sym_b] = ACTIONS(11),
     [anon_sym_bf] = ACTIONS(13),
     [anon_sym_clos] = ACTIONS(15),
+    [anon_sym_addi] = ACTIONS(124),
+    [anon_sym_subi] = ACTIONS(126),
+    [anon_sym_lei] = ACTIONS(128),
+    [anon_sym_eqi] = ACTIONS(130),
     [sym_lab] = ACTIONS(17),
     [sym_comment] = ACTIONS(3),
   },
@@ -1166,6 +1298,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [sym_b] = STATE(10),
     [sym_bf] = STATE(10),
     [sym_clos] = STATE(10),
+    [sym_addi] = STATE(10),
+    [sym_subi] = STATE(10),
+    [sym_lei] = STATE(10),
+    [sym_eqi] = STATE(10),
     [aux_sym_code_repeat1] = STATE(2),
     [ts_builtin_sym_end] = ACTIONS(19),
     [anon_sym_let] = ACTIONS(21),
@@ -1185,6 +1321,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [anon_sym_b] = ACTIONS(30),
     [anon_sym_bf] = ACTIONS(33),
     [anon_sym_clos] = ACTIONS(36),
+    [anon_sym_addi] = ACTIONS(132),
+    [anon_sym_subi] = ACTIONS(135),
+    [anon_sym_lei] = ACTIONS(138),
+    [anon_sym_eqi] = ACTIONS(141),
     [sym_lab] = ACTIONS(39),
     [sym_comment] = ACTIONS(3),
   },
@@ -1198,6 +1338,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [sym_b] = STATE(10),
     [sym_bf] = STATE(10),
     [sym_clos] = STATE(10),
+    [sym_addi] = STATE(10),
+    [sym_subi] = STATE(10),
+    [sym_lei] = STATE(10),
+    [sym_eqi] = STATE(10),
     [aux_sym_code_repeat1] = STATE(2),
     [ts_builtin_sym_end] = ACTIONS(42),
     [anon_sym_let] = ACTIONS(5),
@@ -1217,6 +1361,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [anon_sym_b] = ACTIONS(11),
     [anon_sym_bf] = ACTIONS(13),
     [anon_sym_clos] = ACTIONS(15),
+    [anon_sym_addi] = ACTIONS(124),
+    [anon_sym_subi] = ACTIONS(126),
+    [anon_sym_lei] = ACTIONS(128),
+    [anon_sym_eqi] = ACTIONS(130),
     [sym_lab] = ACTIONS(17),
     [sym_comment] = ACTIONS(3),
   },
@@ -1229,6 +1377,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [sym_b] = STATE(10),
     [sym_bf] = STATE(10),
     [sym_clos] = STATE(10),
+    [sym_addi] = STATE(10),
+    [sym_subi] = STATE(10),
+    [sym_lei] = STATE(10),
+    [sym_eqi] = STATE(10),
     [anon_sym_let] = ACTIONS(44),
     [anon_sym_endlet] = ACTIONS(44),
     [anon_sym_add] = ACTIONS(44),
@@ -1246,6 +1398,10 @@ static const uint16_t ts_parse_table[LARGE_STATE_COUNT][SYMBOL_COUNT] = {
     [anon_sym_b] = ACTIONS(11),
     [anon_sym_bf] = ACTIONS(50),
     [anon_sym_clos] = ACTIONS(52),
+    [anon_sym_addi] = ACTIONS(144),
+    [anon_sym_subi] = ACTIONS(146),
+    [anon_sym_lei] = ACTIONS(148),
+    [anon_sym_eqi] = ACTIONS(150),
     [sym_comment] = ACTIONS(3),
   },
 };
@@ -1256,7 +1412,7 @@ static const uint16_t ts_small_parse_table[] = {
       sym_comment,
     ACTIONS(54), 1,
       ts_builtin_sym_end,
-    ACTIONS(56), 18,
+    ACTIONS(56), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1274,13 +1430,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [27] = 3,
+  [31] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(58), 1,
       ts_builtin_sym_end,
-    ACTIONS(60), 18,
+    ACTIONS(60), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1298,13 +1458,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [54] = 3,
+  [62] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(62), 1,
       ts_builtin_sym_end,
-    ACTIONS(64), 18,
+    ACTIONS(64), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1322,13 +1486,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [81] = 3,
+  [93] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(66), 1,
       ts_builtin_sym_end,
-    ACTIONS(68), 18,
+    ACTIONS(68), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1346,13 +1514,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [108] = 3,
+  [124] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(70), 1,
       ts_builtin_sym_end,
-    ACTIONS(72), 18,
+    ACTIONS(72), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1370,13 +1542,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [135] = 3,
+  [155] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(74), 1,
       ts_builtin_sym_end,
-    ACTIONS(76), 18,
+    ACTIONS(76), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1394,13 +1570,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [162] = 3,
+  [186] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(78), 1,
       ts_builtin_sym_end,
-    ACTIONS(80), 18,
+    ACTIONS(80), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1418,13 +1598,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [189] = 3,
+  [217] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(82), 1,
       ts_builtin_sym_end,
-    ACTIONS(84), 18,
+    ACTIONS(84), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1442,13 +1626,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [216] = 3,
+  [248] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(86), 1,
       ts_builtin_sym_end,
-    ACTIONS(88), 18,
+    ACTIONS(88), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1466,13 +1654,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [243] = 3,
+  [279] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(90), 1,
       ts_builtin_sym_end,
-    ACTIONS(92), 18,
+    ACTIONS(92), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1490,13 +1682,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [270] = 3,
+  [310] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(94), 1,
       ts_builtin_sym_end,
-    ACTIONS(96), 18,
+    ACTIONS(96), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1514,13 +1710,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [297] = 3,
+  [341] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(98), 1,
       ts_builtin_sym_end,
-    ACTIONS(100), 18,
+    ACTIONS(100), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1538,13 +1738,17 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [324] = 3,
+  [372] = 3,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(102), 1,
       ts_builtin_sym_end,
-    ACTIONS(104), 18,
+    ACTIONS(104), 22,
       anon_sym_let,
       anon_sym_endlet,
       anon_sym_add,
@@ -1562,8 +1766,12 @@ static const uint16_t ts_small_parse_table[] = {
       anon_sym_b,
       anon_sym_bf,
       anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
       sym_lab,
-  [351] = 4,
+  [403] = 4,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(106), 2,
@@ -1575,7 +1783,7 @@ static const uint16_t ts_small_parse_table[] = {
     STATE(12), 2,
       sym_integer,
       sym_bool,
-  [367] = 3,
+  [419] = 3,
     ACTIONS(3), 1,
       sym_comment,
     STATE(11), 1,
@@ -1583,60 +1791,212 @@ static const uint16_t ts_small_parse_table[] = {
     ACTIONS(110), 2,
       aux_sym_nat_token1,
       anon_sym_0,
-  [378] = 2,
+  [430] = 2,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(112), 1,
       sym_lab,
-  [385] = 2,
+  [437] = 2,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(114), 1,
       sym_lab,
-  [392] = 2,
+  [444] = 2,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(116), 1,
       ts_builtin_sym_end,
-  [399] = 2,
+  [451] = 2,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(118), 1,
       ts_builtin_sym_end,
-  [406] = 2,
+  [458] = 2,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(120), 1,
       anon_sym_COLON,
-  [413] = 2,
+  [465] = 2,
     ACTIONS(3), 1,
       sym_comment,
     ACTIONS(122), 1,
       sym_lab,
+  [472] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(106), 2,
+      anon_sym_0,
+      aux_sym_integer_token1,
+    STATE(30), 1,
+      sym_integer,
+  [483] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(106), 2,
+      anon_sym_0,
+      aux_sym_integer_token1,
+    STATE(31), 1,
+      sym_integer,
+  [494] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(106), 2,
+      anon_sym_0,
+      aux_sym_integer_token1,
+    STATE(32), 1,
+      sym_integer,
+  [505] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(106), 2,
+      anon_sym_0,
+      aux_sym_integer_token1,
+    STATE(33), 1,
+      sym_integer,
+  [516] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(152), 1,
+      ts_builtin_sym_end,
+    ACTIONS(154), 22,
+      anon_sym_let,
+      anon_sym_endlet,
+      anon_sym_add,
+      anon_sym_sub,
+      anon_sym_le,
+      anon_sym_eq,
+      anon_sym_app,
+      anon_sym_tapp,
+      anon_sym_mark,
+      anon_sym_grab,
+      anon_sym_ret,
+      anon_sym_halt,
+      anon_sym_load,
+      anon_sym_acc,
+      anon_sym_b,
+      anon_sym_bf,
+      anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
+      sym_lab,
+  [547] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(156), 1,
+      ts_builtin_sym_end,
+    ACTIONS(158), 22,
+      anon_sym_let,
+      anon_sym_endlet,
+      anon_sym_add,
+      anon_sym_sub,
+      anon_sym_le,
+      anon_sym_eq,
+      anon_sym_app,
+      anon_sym_tapp,
+      anon_sym_mark,
+      anon_sym_grab,
+      anon_sym_ret,
+      anon_sym_halt,
+      anon_sym_load,
+      anon_sym_acc,
+      anon_sym_b,
+      anon_sym_bf,
+      anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
+      sym_lab,
+  [578] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(160), 1,
+      ts_builtin_sym_end,
+    ACTIONS(162), 22,
+      anon_sym_let,
+      anon_sym_endlet,
+      anon_sym_add,
+      anon_sym_sub,
+      anon_sym_le,
+      anon_sym_eq,
+      anon_sym_app,
+      anon_sym_tapp,
+      anon_sym_mark,
+      anon_sym_grab,
+      anon_sym_ret,
+      anon_sym_halt,
+      anon_sym_load,
+      anon_sym_acc,
+      anon_sym_b,
+      anon_sym_bf,
+      anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
+      sym_lab,
+  [609] = 3,
+    ACTIONS(3), 1,
+      sym_comment,
+    ACTIONS(164), 1,
+      ts_builtin_sym_end,
+    ACTIONS(166), 22,
+      anon_sym_let,
+      anon_sym_endlet,
+      anon_sym_add,
+      anon_sym_sub,
+      anon_sym_le,
+      anon_sym_eq,
+      anon_sym_app,
+      anon_sym_tapp,
+      anon_sym_mark,
+      anon_sym_grab,
+      anon_sym_ret,
+      anon_sym_halt,
+      anon_sym_load,
+      anon_sym_acc,
+      anon_sym_b,
+      anon_sym_bf,
+      anon_sym_clos,
+      anon_sym_addi,
+      anon_sym_subi,
+      anon_sym_lei,
+      anon_sym_eqi,
+      sym_lab,
 };
 
 static const uint32_t ts_small_parse_table_map[] = {
   [SMALL_STATE(5)] = 0,
-  [SMALL_STATE(6)] = 27,
-  [SMALL_STATE(7)] = 54,
-  [SMALL_STATE(8)] = 81,
-  [SMALL_STATE(9)] = 108,
-  [SMALL_STATE(10)] = 135,
-  [SMALL_STATE(11)] = 162,
-  [SMALL_STATE(12)] = 189,
-  [SMALL_STATE(13)] = 216,
-  [SMALL_STATE(14)] = 243,
-  [SMALL_STATE(15)] = 270,
-  [SMALL_STATE(16)] = 297,
-  [SMALL_STATE(17)] = 324,
-  [SMALL_STATE(18)] = 351,
-  [SMALL_STATE(19)] = 367,
-  [SMALL_STATE(20)] = 378,
-  [SMALL_STATE(21)] = 385,
-  [SMALL_STATE(22)] = 392,
-  [SMALL_STATE(23)] = 399,
-  [SMALL_STATE(24)] = 406,
-  [SMALL_STATE(25)] = 413,
+  [SMALL_STATE(6)] = 31,
+  [SMALL_STATE(7)] = 62,
+  [SMALL_STATE(8)] = 93,
+  [SMALL_STATE(9)] = 124,
+  [SMALL_STATE(10)] = 155,
+  [SMALL_STATE(11)] = 186,
+  [SMALL_STATE(12)] = 217,
+  [SMALL_STATE(13)] = 248,
+  [SMALL_STATE(14)] = 279,
+  [SMALL_STATE(15)] = 310,
+  [SMALL_STATE(16)] = 341,
+  [SMALL_STATE(17)] = 372,
+  [SMALL_STATE(18)] = 403,
+  [SMALL_STATE(19)] = 419,
+  [SMALL_STATE(20)] = 430,
+  [SMALL_STATE(21)] = 437,
+  [SMALL_STATE(22)] = 444,
+  [SMALL_STATE(23)] = 451,
+  [SMALL_STATE(24)] = 458,
+  [SMALL_STATE(25)] = 465,
+  [SMALL_STATE(26)] = 472,
+  [SMALL_STATE(27)] = 483,
+  [SMALL_STATE(28)] = 494,
+  [SMALL_STATE(29)] = 505,
+  [SMALL_STATE(30)] = 516,
+  [SMALL_STATE(31)] = 547,
+  [SMALL_STATE(32)] = 578,
+  [SMALL_STATE(33)] = 609,
 };
 
 static const TSParseActionEntry ts_parse_actions[] = {
@@ -1699,6 +2059,26 @@ static const TSParseActionEntry ts_parse_actions[] = {
   [118] = {.entry = {.count = 1, .reusable = true}}, REDUCE(sym_source_file, 1, 0, 1),
   [120] = {.entry = {.count = 1, .reusable = true}}, SHIFT(4),
   [122] = {.entry = {.count = 1, .reusable = true}}, SHIFT(13),
+  [124] = {.entry = {.count = 1, .reusable = false}}, SHIFT(26),
+  [126] = {.entry = {.count = 1, .reusable = false}}, SHIFT(27),
+  [128] = {.entry = {.count = 1, .reusable = false}}, SHIFT(28),
+  [130] = {.entry = {.count = 1, .reusable = false}}, SHIFT(29),
+  [132] = {.entry = {.count = 2, .reusable = false}}, REDUCE(aux_sym_code_repeat1, 2, 0, 0), SHIFT_REPEAT(26),
+  [135] = {.entry = {.count = 2, .reusable = false}}, REDUCE(aux_sym_code_repeat1, 2, 0, 0), SHIFT_REPEAT(27),
+  [138] = {.entry = {.count = 2, .reusable = false}}, REDUCE(aux_sym_code_repeat1, 2, 0, 0), SHIFT_REPEAT(28),
+  [141] = {.entry = {.count = 2, .reusable = false}}, REDUCE(aux_sym_code_repeat1, 2, 0, 0), SHIFT_REPEAT(29),
+  [144] = {.entry = {.count = 1, .reusable = true}}, SHIFT(26),
+  [146] = {.entry = {.count = 1, .reusable = true}}, SHIFT(27),
+  [148] = {.entry = {.count = 1, .reusable = true}}, SHIFT(28),
+  [150] = {.entry = {.count = 1, .reusable = true}}, SHIFT(29),
+  [152] = {.entry = {.count = 1, .reusable = true}}, REDUCE(sym_addi, 2, 0, 5),
+  [154] = {.entry = {.count = 1, .reusable = false}}, REDUCE(sym_addi, 2, 0, 5),
+  [156] = {.entry = {.count = 1, .reusable = true}}, REDUCE(sym_subi, 2, 0, 5),
+  [158] = {.entry = {.count = 1, .reusable = false}}, REDUCE(sym_subi, 2, 0, 5),
+  [160] = {.entry = {.count = 1, .reusable = true}}, REDUCE(sym_lei, 2, 0, 5),
+  [162] = {.entry = {.count = 1, .reusable = false}}, REDUCE(sym_lei, 2, 0, 5),
+  [164] = {.entry = {.count = 1, .reusable = true}}, REDUCE(sym_eqi, 2, 0, 5),
+  [166] = {.entry = {.count = 1, .reusable = false}}, REDUCE(sym_eqi, 2, 0, 5),
 };
 
 #ifdef __cplusplus
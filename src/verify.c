@@ -0,0 +1,814 @@
+#include "verify.h"
+#include "debug.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The verifier interprets the code abstractly, one function body at a
+   time. The state before each instruction records
+
+     - the values pushed by the current function (the "local" part of
+       the argument stack), from the bottom; the accumulator is the top;
+     - the environment, from its head (`acc 0`).
+
+   Values are abstracted by their types. At function entry the local
+   stack is empty and the accumulator holds a value of the caller:
+   either an extra argument or the mark closing the application.
+   Reading the caller's part is left to `grab` and `ret`, which test
+   for the mark at runtime; every other pop must be local. `app`
+   consumes the local stack down to the nearest mark, so a verified
+   function always leaves a mark at the bottom of its callee's part.
+
+   Closures pushed by `StaticClosure L` keep their label in their type,
+   so that the applications of a known closure can be made direct (see
+   `AVM_CallDirect`); other closures are `TY_CLOS`, but for those made
+   by `Closure` and `FlatClosure` at S, which keep S until they meet a
+   use the verifier cannot follow: being passed or returned, captured,
+   stored by a `grab` or merged with another closure. Such a use marks
+   S as escaping; the closures of the other sites never outlive the
+   frame that made them and may be allocated in its region (see
+   `new_region_clos`). The frame entered by such a closure keeps S as
+   well, since its environment may then be in the region too.
+
+   Marks are tracked exactly: a stack slot is never a "maybe mark", and
+   environment slots that may hold one (the slot under a grabbed
+   argument) cannot be loaded.
+
+   The state also tells whether the frame is still as the application
+   of a static closure entered it: the closure and its arguments at its
+   bottom, separated by marks, and no environment beyond. A tail call
+   of the same closure can then bind its arguments in place.
+
+   The state also bounds the values the current frame has put in the
+   environment cache. Once the types are stable, the bounds of every
+   instruction are propagated backwards to the instructions that reach
+   it within a frame, giving the space a frame entered at each address
+   may use (see `AVM_frame_size_t`). */
+
+typedef enum {
+  TY_INT,
+  TY_BOOL,
+  TY_CLOS,
+  TY_VALUE,   /* any value but a mark */
+  TY_MARK,
+  TY_TOP,     /* anything, including a mark */
+  TY_STATIC,  /* TY_STATIC + 2 * L: the static closure of L;
+                 TY_STATIC + 2 * S + 1: a closure made at S */
+} ty_t;
+
+static _Bool is_clos_ty(ty_t t) {
+  return t == TY_CLOS || t >= TY_STATIC;
+}
+
+static ty_t static_ty(int l) {
+  return TY_STATIC + 2 * l;
+}
+
+static ty_t local_ty(int s) {
+  return TY_STATIC + 2 * s + 1;
+}
+
+/* L for the static closure of L, -1 for other types. */
+static int static_label(ty_t t) {
+  return t >= TY_STATIC && (t - TY_STATIC) % 2 == 0 ? (int)(t - TY_STATIC) / 2 : -1;
+}
+
+/* S for a closure made at S, -1 for other types. */
+static int local_site(ty_t t) {
+  return t >= TY_STATIC && (t - TY_STATIC) % 2 == 1 ? (int)(t - TY_STATIC) / 2 : -1;
+}
+
+typedef struct {
+  _Bool visited;
+  _Bool root;     /* reached from the top level without a call */
+  int depth;
+  int env_size;
+  int frame_env;  /* at most this many values pushed to the cache */
+  int self;       /* L when the frame is the intact one of the static
+                     closure of L, -1 otherwise */
+  int site;       /* S when the frame is of a closure made at S, -1
+                     otherwise */
+  ty_t *stack;    /* stack[depth - 1] is the top */
+  ty_t *env;      /* env[0] is the head */
+} state_t;
+
+static AVM_verify_error verify_error;
+
+AVM_verify_error *last_verify_error(void) {
+  return &verify_error;
+}
+
+/* Records why verification failed at `pc`; always returns false. */
+static _Bool reject(int pc, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  verify_error.pc = pc;
+  vsnprintf(verify_error.message, sizeof(verify_error.message), fmt, ap);
+  va_end(ap);
+  return false;
+}
+
+static ty_t join_ty(ty_t a, ty_t b) {
+  if (a == b)
+    return a;
+  if (is_clos_ty(a) && is_clos_ty(b))
+    return TY_CLOS;
+  if (a == TY_MARK || b == TY_MARK || a == TY_TOP || b == TY_TOP)
+    return TY_TOP;
+  return TY_VALUE;
+}
+
+static ty_t *copy_tys(ty_t *tys, int size) {
+  ty_t *res = malloc(sizeof(ty_t) * (size > 0 ? size : 1));
+  if (res == NULL)
+    error("verify_code: Couldn't allocate an abstract state.");
+  if (size > 0)
+    memcpy(res, tys, sizeof(ty_t) * size);
+  return res;
+}
+
+static void free_state(state_t *s) {
+  free(s->stack);
+  free(s->env);
+  s->stack = NULL;
+  s->env = NULL;
+}
+
+/* Marks the closures of type `t`, if made at some site, as escaping. */
+static void escape(_Bool *escapes, ty_t t) {
+  int s = local_site(t);
+  if (s >= 0)
+    escapes[s] = true;
+}
+
+static void escape_all(_Bool *escapes, ty_t *tys, int size) {
+  for (int i = 0; i < size; ++i)
+    escape(escapes, tys[i]);
+}
+
+/* Joins `in` into `out` and tells whether `out` changed. Fails when
+   the stacks have different shapes. The closures whose site a join
+   forgets escape. */
+static _Bool join_state(int pc, state_t *out, state_t *in, _Bool *escapes,
+                        _Bool *changed) {
+  *changed = false;
+
+  if (!out->visited) {
+    *out = (state_t){ .visited = true, .root = in->root,
+                      .depth = in->depth, .env_size = in->env_size,
+                      .frame_env = in->frame_env, .self = in->self,
+                      .site = in->site,
+                      .stack = copy_tys(in->stack, in->depth),
+                      .env = copy_tys(in->env, in->env_size) };
+    *changed = true;
+    return true;
+  }
+
+  if (out->depth != in->depth)
+    return reject(pc, "The stack has %d or %d values depending on the path.",
+                  out->depth, in->depth);
+
+  for (int i = 0; i < out->depth; ++i) {
+    ty_t t = join_ty(out->stack[i], in->stack[i]);
+    if (t == TY_TOP)
+      return reject(pc, "A mark is on the stack only on some paths.");
+    if (t != out->stack[i]) {
+      escape(escapes, out->stack[i]);
+      escape(escapes, in->stack[i]);
+      out->stack[i] = t;
+      *changed = true;
+    }
+  }
+
+  if (in->env_size < out->env_size) {
+    escape_all(escapes, out->env + in->env_size, out->env_size - in->env_size);
+    out->env_size = in->env_size;
+    *changed = true;
+  }
+  escape_all(escapes, in->env + out->env_size, in->env_size - out->env_size);
+  for (int i = 0; i < out->env_size; ++i) {
+    ty_t t = join_ty(out->env[i], in->env[i]);
+    if (t != out->env[i]) {
+      escape(escapes, out->env[i]);
+      escape(escapes, in->env[i]);
+      out->env[i] = t;
+      *changed = true;
+    }
+  }
+
+  if (in->frame_env > out->frame_env) {
+    out->frame_env = in->frame_env;
+    *changed = true;
+  }
+
+  if (in->self != out->self && out->self != -1) {
+    out->self = -1;
+    *changed = true;
+  }
+
+  if (in->site != out->site) {
+    if (in->site >= 0)
+      escapes[in->site] = true;
+    if (out->site >= 0) {
+      escapes[out->site] = true;
+      out->site = -1;
+      *changed = true;
+    }
+  }
+
+  if (in->root && !out->root) {
+    out->root = true;
+    *changed = true;
+  }
+
+  return true;
+}
+
+/* The state of the instruction being interpreted. Its arrays are large
+   enough for the pushes of a single instruction. */
+typedef struct {
+  state_t s;
+  int stack_cap;
+  int env_cap;
+} cursor_t;
+
+static void push_ty(cursor_t *c, ty_t t) {
+  if (c->s.depth == c->stack_cap) {
+    c->stack_cap = c->stack_cap * 2 + 2;
+    c->s.stack = realloc(c->s.stack, sizeof(ty_t) * c->stack_cap);
+    if (c->s.stack == NULL)
+      error("verify_code: Couldn't allocate an abstract state.");
+  }
+  c->s.stack[c->s.depth++] = t;
+}
+
+static void extend_ty(cursor_t *c, ty_t t) {
+  if (c->s.env_size == c->env_cap) {
+    c->env_cap = c->env_cap * 2 + 2;
+    c->s.env = realloc(c->s.env, sizeof(ty_t) * c->env_cap);
+    if (c->s.env == NULL)
+      error("verify_code: Couldn't allocate an abstract state.");
+  }
+  memmove(c->s.env + 1, c->s.env, sizeof(ty_t) * c->s.env_size);
+  c->s.env[0] = t;
+  ++c->s.env_size;
+}
+
+typedef struct {
+  AVM_code_t *code;
+  _Bool ignite;
+  state_t *states;     /* indexed by pc */
+  AVM_frame_size_t *peaks; /* the most an instruction uses */
+  int *worklist;
+  int worklist_size;
+  _Bool *queued;
+  int *callees;        /* the label of each known callee, or -1 */
+  _Bool *loops;        /* the tail calls re-entering their own frame */
+  _Bool *escapes;      /* the sites whose closures may escape */
+} verifier_t;
+
+static _Bool flow(verifier_t *v, int from, int to, state_t *s) {
+  if (to < 0 || to > v->code->instr_size)
+    return reject(from, "Address %d is out of the code.", to);
+  if (to == v->code->instr_size)
+    return true; /* the appended halt */
+  /* Without loops, no instruction extends the environment by more than
+     two values on the way. */
+  if (s->frame_env > 2 * v->code->instr_size + 2)
+    return reject(from, "The environment grows on every iteration of a loop.");
+
+  _Bool changed;
+  if (!join_state(from, &v->states[to], s, v->escapes, &changed))
+    return false;
+  if (changed && !v->queued[to]) {
+    v->queued[to] = true;
+    v->worklist[v->worklist_size++] = to;
+  }
+  return true;
+}
+
+/* The number of `grab`s at `addr` and right after it. */
+static int leading_grabs(AVM_code_t *code, int addr) {
+  int n = 0;
+  while (addr + n < code->instr_size && code->instr[addr + n].kind == AVM_Grab)
+    ++n;
+  return n;
+}
+
+/* Flows the entry of a closure of `addr` whose body is entered with
+   the `n` captured values of type `captured`, the top first, then the
+   closure itself (`self`) and its argument. */
+static _Bool flow_entry(verifier_t *v, int pc, int addr, ty_t *captured, int n,
+                        ty_t self) {
+  cursor_t entry = { .s = { .visited = true, .root = false, .depth = 0,
+                            .env_size = 0, .frame_env = 2,
+                            .self = static_label(self),
+                            .site = local_site(self),
+                            .stack = NULL, .env = NULL },
+                     .stack_cap = 0, .env_cap = 0 };
+  for (int i = 0; i < n; ++i)
+    extend_ty(&entry, captured[i]);
+  extend_ty(&entry, self);
+  extend_ty(&entry, TY_VALUE);
+  _Bool ok = flow(v, pc, addr, &entry.s);
+  free_state(&entry.s);
+  return ok;
+}
+
+/* Rejects the instruction being interpreted by `step`. */
+#define REJECT(pc, ...)                                               \
+  do {                                                                \
+    reject((pc), __VA_ARGS__);                                        \
+    goto fail;                                                        \
+  } while (0)
+/* Pops a local value of the current function into `dst`. */
+#define POP(dst)                                                      \
+  do {                                                                \
+    if (c.s.depth == 0)                                               \
+      REJECT(pc, "Pops a value the function did not push.");          \
+    (dst) = c.s.stack[--c.s.depth];                                   \
+  } while (0)
+/* Pops a value that must not be a mark. */
+#define POP_VALUE(dst)                                                \
+  do {                                                                \
+    POP(dst);                                                         \
+    if ((dst) == TY_MARK)                                             \
+      REJECT(pc, "Uses a mark as a value.");                          \
+  } while (0)
+#define LOOKUP(dst, index)                                            \
+  do {                                                                \
+    int _i = (index);                                                 \
+    if (_i < 0 || _i >= c.s.env_size)                                 \
+      REJECT(pc, "Variable %d is not bound (%d in scope).", _i,       \
+             c.s.env_size);                                           \
+    (dst) = c.s.env[_i];                                              \
+    if ((dst) == TY_MARK || (dst) == TY_TOP)                          \
+      REJECT(pc, "Variable %d may hold a mark.", _i);                 \
+  } while (0)
+#define FLOW(to)                                                      \
+  do {                                                                \
+    if (!flow(v, pc, (to), &c.s))                                     \
+      goto fail;                                                      \
+  } while (0)
+
+/* Consumes the arguments of an application down to the nearest mark;
+   they escape to the callee. */
+static _Bool pop_application(verifier_t *v, cursor_t *c) {
+  while (c->s.depth > 0) {
+    ty_t t = c->s.stack[--c->s.depth];
+    if (t == TY_MARK)
+      return true;
+    escape(v->escapes, t);
+  }
+  return false;
+}
+
+static _Bool has_mark(cursor_t *c) {
+  for (int i = 0; i < c->s.depth; ++i)
+    if (c->s.stack[i] == TY_MARK)
+      return true;
+  return false;
+}
+
+/* The number of arguments the application `instr` binds at once. */
+static int bound_arguments(AVM_instr_t *instr) {
+  switch (instr->kind) {
+  case AVM_ApplyN:
+  case AVM_TailApplyN:
+  case AVM_AccApplyN:
+  case AVM_AccTailApplyN:
+  case AVM_CallDirect:
+  case AVM_TailCallDirect:
+    return instr->const_int;
+  default:
+    return 1;
+  }
+}
+
+/* Whether the values `ApplyN n` and the like bind besides the first
+   argument, the n - 1 on top of the stack, are there and no marks, and
+   there is one more below them to take the top of the stack. That one
+   may be the caller's, which a `grab` would have read as well. */
+static _Bool has_arguments(cursor_t *c, AVM_instr_t *instr, _Bool caller) {
+  switch (instr->kind) {
+  case AVM_ApplyN:
+  case AVM_TailApplyN:
+  case AVM_AccApplyN:
+  case AVM_AccTailApplyN:
+    break;
+  case AVM_CallDirect:
+  case AVM_TailCallDirect:
+    if (instr->const_int == 1)
+      return true;
+    break;
+  default:
+    return true;
+  }
+  int n = instr->const_int;
+  if (n < 2 || c->s.depth < (caller ? n - 1 : n))
+    return false;
+  for (int i = c->s.depth - n + 1; i < c->s.depth; ++i)
+    if (c->s.stack[i] == TY_MARK || c->s.stack[i] == TY_TOP)
+      return false;
+  return true;
+}
+
+/* Whether the function has a caller that left a mark below its
+   arguments. */
+#define HAS_CALLER() (!c.s.root || v->ignite)
+
+static _Bool step(verifier_t *v, int pc, _Bool *unchecked) {
+  AVM_instr_t *instr = &v->code->instr[pc];
+  state_t *in = &v->states[pc];
+  cursor_t c = { .s = { .visited = true, .root = in->root,
+                        .depth = in->depth, .env_size = in->env_size,
+                        .frame_env = in->frame_env, .self = in->self,
+                        .site = in->site,
+                        .stack = copy_tys(in->stack, in->depth),
+                        .env = copy_tys(in->env, in->env_size) },
+                 .stack_cap = in->depth > 0 ? in->depth : 1,
+                 .env_cap = in->env_size > 0 ? in->env_size : 1 };
+  ty_t a = TY_VALUE, b = TY_VALUE;
+  _Bool typed = true;
+
+  switch (instr->kind) {
+  case AVM_Ldi:
+    push_ty(&c, TY_INT);
+    FLOW(pc + 1);
+    break;
+  case AVM_Ldb:
+    push_ty(&c, TY_BOOL);
+    FLOW(pc + 1);
+    break;
+  case AVM_Access:
+    LOOKUP(a, instr->access);
+    push_ty(&c, a);
+    FLOW(pc + 1);
+    break;
+  case AVM_Closure: {
+    if (instr->addr < 0 || instr->addr >= v->code->instr_size)
+      REJECT(pc, "Closure address %d is out of the code.", instr->addr);
+    /* `perpetuate` moves the frame out of the cache, and the region
+       with it. */
+    escape_all(v->escapes, c.s.env, c.s.env_size);
+    if (c.s.site >= 0)
+      v->escapes[c.s.site] = true;
+    /* The body is entered with the closure and its argument. */
+    cursor_t entry = { .s = { .visited = true, .root = false, .depth = 0,
+                              .env_size = c.s.env_size, .frame_env = 2,
+                              .self = -1, .site = pc, .stack = NULL,
+                              .env = copy_tys(c.s.env, c.s.env_size) },
+                       .stack_cap = 0, .env_cap = c.s.env_size };
+    extend_ty(&entry, local_ty(pc));
+    extend_ty(&entry, TY_VALUE);
+    _Bool ok = flow(v, pc, instr->addr, &entry.s);
+    free_state(&entry.s);
+    if (!ok)
+      goto fail;
+    c.s.self = -1;
+    push_ty(&c, local_ty(pc));
+    FLOW(pc + 1);
+    break;
+  }
+  case AVM_FlatClosure:
+  case AVM_StaticClosure: {
+    if (instr->addr < 0 || instr->addr >= v->code->instr_size)
+      REJECT(pc, "Closure address %d is out of the code.", instr->addr);
+    int n = instr->kind == AVM_FlatClosure ? instr->const_int : 0;
+    if (n < 0 || n > c.s.depth)
+      REJECT(pc, "Captures %d values out of %d.", n, c.s.depth);
+    for (int i = c.s.depth - n; i < c.s.depth; ++i)
+      if (c.s.stack[i] == TY_MARK || c.s.stack[i] == TY_TOP)
+        REJECT(pc, "Captures a mark.");
+    escape_all(v->escapes, c.s.stack + c.s.depth - n, n);
+    ty_t self = instr->kind == AVM_StaticClosure ? static_ty(instr->addr) : local_ty(pc);
+    if (!flow_entry(v, pc, instr->addr, c.s.stack + c.s.depth - n, n, self))
+      goto fail;
+    c.s.depth -= n;
+    push_ty(&c, self);
+    FLOW(pc + 1);
+    break;
+  }
+  case AVM_Let:
+    POP_VALUE(a);
+    extend_ty(&c, a);
+    ++c.s.frame_env;
+    FLOW(pc + 1);
+    break;
+  case AVM_EndLet:
+    if (c.s.env_size == 0)
+      REJECT(pc, "The environment may be empty.");
+    memmove(c.s.env, c.s.env + 1, sizeof(ty_t) * --c.s.env_size);
+    if (c.s.frame_env > 0)
+      --c.s.frame_env;
+    /* The environment of a static closure is its frame. */
+    if (c.s.self >= 0 && c.s.env_size < 2 * (1 + leading_grabs(v->code, c.s.self)))
+      c.s.self = -1;
+    FLOW(pc + 1);
+    break;
+  case AVM_Jump:
+    FLOW(instr->addr);
+    break;
+  case AVM_CJump:
+    POP(a);
+    typed = a == TY_BOOL;
+    FLOW(instr->addr);
+    FLOW(pc + 1);
+    break;
+  case AVM_Add:
+  case AVM_Sub:
+  case AVM_Le:
+  case AVM_Eq:
+    POP(b);
+    POP(a);
+    typed = a == TY_INT && b == TY_INT;
+    push_ty(&c, instr->kind == AVM_Add || instr->kind == AVM_Sub ? TY_INT : TY_BOOL);
+    FLOW(pc + 1);
+    break;
+  case AVM_AddImm:
+  case AVM_SubImm:
+  case AVM_LeImm:
+  case AVM_EqImm:
+    POP(a);
+    typed = a == TY_INT;
+    push_ty(&c, instr->kind == AVM_AddImm || instr->kind == AVM_SubImm ? TY_INT : TY_BOOL);
+    FLOW(pc + 1);
+    break;
+  case AVM_CallDirect:
+  case AVM_TailCallDirect:
+    if (instr->addr < 0 || instr->addr >= v->code->instr_size)
+      REJECT(pc, "Closure address %d is out of the code.", instr->addr);
+    a = static_ty(instr->addr);
+    if (!flow_entry(v, pc, instr->addr, NULL, 0, a))
+      goto fail;
+    POP_VALUE(b);
+    typed = has_arguments(&c, instr, HAS_CALLER());
+    if (instr->kind == AVM_TailCallDirect)
+      goto tail_call;
+    goto call;
+  case AVM_Apply:
+  case AVM_AccApply:
+  case AVM_ApplyN:
+  case AVM_AccApplyN:
+    if (instr->kind == AVM_Apply || instr->kind == AVM_ApplyN)
+      POP(a);
+    else
+      LOOKUP(a, instr->access);
+    POP_VALUE(b);
+    typed = is_clos_ty(a) && has_arguments(&c, instr, HAS_CALLER());
+  call:
+    v->callees[pc] = static_label(a);
+    escape(v->escapes, b);
+    if (!pop_application(v, &c))
+      REJECT(pc, "Applies a function without a mark.");
+    push_ty(&c, TY_VALUE);
+    FLOW(pc + 1);
+    break;
+  case AVM_TailApply:
+  case AVM_AccTailApply:
+  case AVM_TailApplyN:
+  case AVM_AccTailApplyN:
+    if (instr->kind == AVM_TailApply || instr->kind == AVM_TailApplyN)
+      POP(a);
+    else
+      LOOKUP(a, instr->access);
+    POP_VALUE(b);
+    typed = is_clos_ty(a) && has_arguments(&c, instr, HAS_CALLER());
+  tail_call:
+    v->callees[pc] = static_label(a);
+    /* The frame, and its region, ends before the callee runs. */
+    escape(v->escapes, a);
+    escape(v->escapes, b);
+    escape_all(v->escapes, c.s.stack, c.s.depth);
+    /* Calling the frame's own closure with the whole local stack, the
+       frame only changes its arguments. */
+    v->loops[pc] = v->callees[pc] >= 0 && v->callees[pc] == c.s.self &&
+      c.s.depth == bound_arguments(instr) - 1;
+    if (has_mark(&c))
+      REJECT(pc, "Leaves a mark to the tail-called function.");
+    if (!HAS_CALLER())
+      REJECT(pc, "Tail-calls from the top level without a caller.");
+    break;
+  case AVM_PushMark:
+    push_ty(&c, TY_MARK);
+    FLOW(pc + 1);
+    break;
+  case AVM_Grab:
+    if (c.s.depth != 0)
+      REJECT(pc, "Grabs an argument below %d local values.", c.s.depth);
+    if (!HAS_CALLER())
+      REJECT(pc, "Grabs an argument at the top level without a caller.");
+    /* Only a leading grab of a frame holding nothing but the closure and
+       its arguments returns a PAP on a mark; the others capture the
+       frame in a closure, which enters the next instruction with a frame
+       of its own. */
+    /* Either way, the frame, or the closure in it, may outlive it. */
+    escape_all(v->escapes, c.s.env, c.s.env_size);
+    if (c.s.site >= 0)
+      v->escapes[c.s.site] = true;
+    if (c.s.self >= 0) {
+      int j = pc - c.s.self;
+      if (j < 0 || j >= leading_grabs(v->code, c.s.self) ||
+          c.s.env_size != 2 + 2 * j || c.s.frame_env != 2 + 2 * j)
+        c.s.self = -1;
+    }
+    extend_ty(&c, TY_TOP);
+    extend_ty(&c, TY_VALUE);
+    c.s.frame_env += 2;
+    FLOW(pc + 1);
+    break;
+  case AVM_Return:
+    if (c.s.depth != 1 || c.s.stack[0] == TY_MARK)
+      REJECT(pc, "Returns with %d local values instead of a result.", c.s.depth);
+    if (!HAS_CALLER())
+      REJECT(pc, "Returns from the top level without a caller.");
+    escape(v->escapes, c.s.stack[0]);
+    break;
+  case AVM_Halt:
+    escape_all(v->escapes, c.s.stack, c.s.depth);
+    break;
+  case AVM_AccAccLeBf:
+    LOOKUP(a, instr->access);
+    LOOKUP(b, instr->access2);
+    typed = a == TY_INT && b == TY_INT;
+    FLOW(instr->addr);
+    FLOW(pc + 1);
+    break;
+  case AVM_AccSubImm:
+    LOOKUP(a, instr->access);
+    typed = a == TY_INT;
+    push_ty(&c, TY_INT);
+    FLOW(pc + 1);
+    break;
+  case AVM_MarkAcc:
+    LOOKUP(a, instr->access);
+    push_ty(&c, TY_MARK);
+    push_ty(&c, a);
+    FLOW(pc + 1);
+    break;
+  case AVM_BranchIfGt:
+  case AVM_BranchIfNe:
+    POP(b);
+    POP(a);
+    typed = a == TY_INT && b == TY_INT;
+    FLOW(instr->addr);
+    FLOW(pc + 1);
+    break;
+  case AVM_BranchIfGtImm:
+  case AVM_BranchIfNeImm:
+    POP(a);
+    typed = a == TY_INT;
+    FLOW(instr->addr);
+    FLOW(pc + 1);
+    break;
+  default:
+    REJECT(pc, "Unknown instruction kind %d.", instr->kind);
+  }
+
+  unchecked[pc] = typed;
+  v->peaks[pc] = (AVM_frame_size_t){
+    .stack = in->depth > c.s.depth ? in->depth : c.s.depth,
+    .env = in->frame_env > c.s.frame_env ? in->frame_env : c.s.frame_env };
+  free_state(&c.s);
+  return true;
+
+ fail:
+  free_state(&c.s);
+  return false;
+}
+
+#undef REJECT
+#undef POP
+#undef POP_VALUE
+#undef LOOKUP
+#undef FLOW
+#undef HAS_CALLER
+
+int frame_successors(AVM_instr_t *instr, int pc, int next[2]) {
+  switch (instr->kind) {
+  case AVM_Jump:
+    next[0] = instr->addr;
+    return 1;
+  case AVM_CJump:
+  case AVM_AccAccLeBf:
+  case AVM_BranchIfGt:
+  case AVM_BranchIfNe:
+  case AVM_BranchIfGtImm:
+  case AVM_BranchIfNeImm:
+    next[0] = pc + 1;
+    next[1] = instr->addr;
+    return 2;
+  case AVM_TailApply:
+  case AVM_AccTailApply:
+  case AVM_TailApplyN:
+  case AVM_AccTailApplyN:
+  case AVM_TailCallDirect:
+  case AVM_SelfTailCall:
+  case AVM_Return:
+  case AVM_Halt:
+    return 0;
+  default:
+    next[0] = pc + 1;
+    return 1;
+  }
+}
+
+/* Computes in `frames[pc]` the most a frame entered at `pc` uses,
+   i.e. the largest peak reachable from `pc` within the frame. */
+static void bound_frames(verifier_t *v, AVM_frame_size_t *frames) {
+  int n = v->code->instr_size;
+  for (int pc = 0; pc <= n; ++pc)
+    frames[pc] = v->peaks[pc];
+
+  _Bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int pc = n - 1; pc >= 0; --pc) {
+      if (!v->states[pc].visited)
+        continue;
+      int next[2];
+      int k = frame_successors(&v->code->instr[pc], pc, next);
+      for (int j = 0; j < k; ++j) {
+        if (next[j] >= n)
+          continue;
+        AVM_frame_size_t *f = &frames[pc], *g = &frames[next[j]];
+        if (g->stack > f->stack) {
+          f->stack = g->stack;
+          changed = true;
+        }
+        if (g->env > f->env) {
+          f->env = g->env;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  /* Whatever is applied, the closure and its argument are bound. */
+  for (int pc = 0; pc <= n; ++pc)
+    if (frames[pc].env < 2)
+      frames[pc].env = 2;
+}
+
+_Bool verify_code(AVM_code_t *code, _Bool ignite, AVM_verify_result_t *result) {
+  int n = code->instr_size;
+  verifier_t v = { .code = code, .ignite = ignite,
+                   .states = calloc(n + 1, sizeof(state_t)),
+                   .peaks = calloc(n + 1, sizeof(AVM_frame_size_t)),
+                   .worklist = malloc(sizeof(int) * (n + 1)),
+                   .worklist_size = 0,
+                   .queued = calloc(n + 1, sizeof(_Bool)),
+                   .callees = malloc(sizeof(int) * (n + 1)),
+                   .loops = calloc(n + 1, sizeof(_Bool)),
+                   .escapes = calloc(n + 1, sizeof(_Bool)) };
+  _Bool *typed = calloc(n + 1, sizeof(_Bool));
+  if (v.states == NULL || v.peaks == NULL || v.worklist == NULL || v.queued == NULL ||
+      v.callees == NULL || v.loops == NULL || v.escapes == NULL || typed == NULL)
+    error("verify_code: Couldn't allocate the verifier.");
+  for (int pc = 0; pc <= n; ++pc)
+    v.callees[pc] = -1;
+
+  _Bool ok = true;
+  verify_error = (AVM_verify_error){ .pc = -1, .message = "" };
+
+  if (n > 0) {
+    state_t entry = { .visited = true, .root = true, .self = -1, .site = -1 };
+    ok = flow(&v, 0, 0, &entry);
+  }
+
+  while (ok && v.worklist_size > 0) {
+    int pc = v.worklist[--v.worklist_size];
+    v.queued[pc] = false;
+    ok = step(&v, pc, typed);
+  }
+
+  AVM_verify_result_t r = ok && result != NULL ? *result : (AVM_verify_result_t){ 0 };
+  if (r.unchecked != NULL)
+    for (int pc = 0; pc < n; ++pc)
+      r.unchecked[pc] = v.states[pc].visited && typed[pc];
+  if (r.frames != NULL)
+    bound_frames(&v, r.frames);
+  if (r.callees != NULL)
+    for (int pc = 0; pc <= n; ++pc)
+      r.callees[pc] = v.callees[pc];
+  if (r.loops != NULL)
+    for (int pc = 0; pc <= n; ++pc)
+      r.loops[pc] = v.loops[pc];
+  if (r.regions != NULL)
+    for (int pc = 0; pc <= n; ++pc)
+      r.regions[pc] = pc < n && v.states[pc].visited && !v.escapes[pc] &&
+        (code->instr[pc].kind == AVM_Closure || code->instr[pc].kind == AVM_FlatClosure);
+
+  for (int pc = 0; pc <= n; ++pc)
+    free_state(&v.states[pc]);
+  free(v.states);
+  free(v.peaks);
+  free(v.worklist);
+  free(v.queued);
+  free(v.callees);
+  free(v.loops);
+  free(v.escapes);
+  free(typed);
+  return ok;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "code.h"
+
+/* What `verify_code` proves of each instruction, in the arrays that
+   are not NULL, of `code->instr_size + 1` entries each:
+   - `unchecked[pc]`: the operand types of instruction `pc` are proven
+     as well, so that every runtime check of the instruction is
+     redundant;
+   - `frames[pc]`: bounds the space used by a frame entered at `pc`;
+   - `callees[pc]`: L when the application at `pc` always applies the
+     static closure of L, and -1 otherwise;
+   - `loops[pc]`: the tail call at `pc` applies the closure of its own
+     frame, still holding it and its arguments as they were bound, to
+     all the values the frame pushed;
+   - `regions[pc]`: the closure made at `pc` never outlives the frame
+     making it. */
+typedef struct {
+  _Bool            *unchecked;
+  AVM_frame_size_t *frames;
+  int              *callees;
+  _Bool            *loops;
+  _Bool            *regions;
+} AVM_verify_result_t;
+
+/* Statically checks `code` as it will be run from address 0. `ignite`
+   tells whether the VM starts with a mark and a return frame to the
+   end of the code (see `init_vm`), so that the top level may `ret`.
+
+   A verified program never pops an empty argument stack, never looks
+   up a variable beyond the environment, never removes the head of an
+   empty environment and only jumps inside the code. When verification
+   succeeds and `result` is not NULL, the arrays it points to are
+   filled in. */
+_Bool verify_code(AVM_code_t *code, _Bool ignite, AVM_verify_result_t *result);
+
+/* Stores in `next` the addresses where the frame continues after the
+   instruction `instr` at `pc`, and returns their number. Calls run in
+   frames of their own. */
+int frame_successors(AVM_instr_t *instr, int pc, int next[2]);
+
+typedef struct {
+  int  pc;
+  char message[128];
+} AVM_verify_error;
+
+/* Describes why the last call to `verify_code` failed. */
+AVM_verify_error *last_verify_error(void);
@@ -1,30 +1,176 @@
 
 #include "vm.h"
 #include "array.h"
+#include "debug.h"
+#include "lower.h"
+#include "optimize.h"
 #include "memory.h"
 #include "runtime.h"
+#include "verify.h"
 #include <stdlib.h>
 
 AVM_value_t epsilon = VAL_EPSILON;
 
+/* Counts the leading grabs of each address, backwards. */
+static void count_arities(AVM_VM *vm) {
+  int size = vm->code->instr_size + 1;
+  vm->frames[size - 1].arity = 1;
+  for (int pc = size - 2; pc >= 0; --pc)
+    vm->frames[pc].arity = vm->code->instr[pc].kind == AVM_Grab
+      ? vm->frames[pc + 1].arity + 1 : 1;
+}
+
+/* Turns the `AccApply`s of the static closures in `callees` (see
+   `verify_code`) into direct calls, and bounds the arguments of every
+   direct call by the arity of its callee. The verified direct tail
+   calls in `loops` bind their arguments in place instead. */
+static void resolve_calls(AVM_VM *vm, int *callees, _Bool *loops, _Bool *unchecked) {
+  for (int pc = 0; pc < vm->code->instr_size; ++pc) {
+    AVM_instr_t *instr = &vm->code->instr[pc];
+    int callee = callees != NULL ? callees[pc] : -1;
+
+    if (callee >= 0) {
+      switch (instr->kind) {
+      case AVM_AccApply:
+      case AVM_AccApplyN:
+        *instr = (AVM_instr_t){ .kind = AVM_CallDirect, .addr = callee,
+          .const_int = instr->kind == AVM_AccApply ? 1 : instr->const_int };
+        break;
+      case AVM_AccTailApply:
+      case AVM_AccTailApplyN:
+        *instr = (AVM_instr_t){ .kind = AVM_TailCallDirect, .addr = callee,
+          .const_int = instr->kind == AVM_AccTailApply ? 1 : instr->const_int };
+        break;
+      default:
+        break;
+      }
+    }
+
+    if ((instr->kind == AVM_CallDirect || instr->kind == AVM_TailCallDirect) &&
+        instr->const_int > vm->frames[instr->addr].arity)
+      instr->const_int = vm->frames[instr->addr].arity;
+    else if (instr->kind == AVM_TailCallDirect && loops != NULL && loops[pc] && unchecked[pc])
+      *instr = (AVM_instr_t){ .kind = AVM_SelfTailCall,
+                              .addr = instr->addr + instr->const_int - 1,
+                              .const_int = instr->const_int };
+  }
+}
+
+/* Verifies the code of `vm`, sizes the frames, makes the calls of known
+   closures direct and lowers the code, flagging the instructions whose
+   runtime checks are proven redundant so that `run()` skips them, and
+   the closures that never escape their frame. */
+static _Bool verify_instrs(AVM_VM *vm, _Bool ignite) {
+  int size = vm->code->instr_size + 1;
+  _Bool *unchecked = calloc(size, sizeof(_Bool));
+  int *callees = malloc(sizeof(int) * size);
+  _Bool *loops = calloc(size, sizeof(_Bool));
+  _Bool *regions = calloc(size, sizeof(_Bool));
+  vm->frames = malloc(sizeof(AVM_frame_size_t) * size);
+  if (unchecked == NULL || callees == NULL || loops == NULL || regions == NULL ||
+      vm->frames == NULL)
+    error("init_vm: Couldn't allocate the verifier's results.");
+
+  AVM_verify_result_t result = { .unchecked = unchecked, .frames = vm->frames,
+                                 .callees = callees, .loops = loops,
+                                 .regions = regions };
+  _Bool verified = verify_code(vm->code, ignite, &result);
+  if (!verified)
+    for (int i = 0; i < size; ++i)
+      vm->frames[i] = (AVM_frame_size_t){ .stack = 0, .env = 2 };
+  count_arities(vm);
+  if (verified)
+    resolve_calls(vm, callees, loops, unchecked);
+  else
+    resolve_calls(vm, NULL, NULL, NULL);
+
+  vm->ops = lower_code(vm->code);
+  if (verified)
+    for (int i = 0; i < vm->code->instr_size; ++i) {
+      if (unchecked[i])
+        vm->ops[i].flags |= AVM_OP_UNCHECKED;
+      if (regions[i])
+        vm->ops[i].flags |= AVM_OP_REGION;
+    }
+  free(unchecked);
+  free(callees);
+  free(loops);
+  free(regions);
+  return verified;
+}
+
+/* Allocates the closure of each label a `StaticClosure` or a direct
+   call refers to. */
+static void bind_statics(AVM_VM *vm) {
+  int size = vm->code->instr_size + 1;
+  vm->statics = malloc(sizeof(AVM_value_t) * size);
+  if (vm->statics == NULL)
+    error("init_vm: Couldn't allocate the static closures.");
+
+  for (int i = 0; i < size; ++i)
+    vm->statics[i] = VAL_NONE;
+  for (int pc = 0; pc < vm->code->instr_size; ++pc) {
+    AVM_instr_t *instr = &vm->code->instr[pc];
+    if ((instr->kind == AVM_StaticClosure || instr->kind == AVM_CallDirect ||
+         instr->kind == AVM_TailCallDirect) && vm->statics[instr->addr] == VAL_NONE)
+      vm->statics[instr->addr] = new_static_clos(instr->addr);
+  }
+}
+
 AVM_VM* init_vm(AVM_code_t *src, _Bool ignite) {
   AVM_VM *vm = malloc(sizeof(AVM_VM));
-  vm->code = src;
+  vm->code = optimize_code(src);
+  vm->verified = verify_instrs(vm, ignite);
+  bind_statics(vm);
   vm->pc = 0;
+  vm->acc = VAL_NONE;
   vm->objs = NULL;
+  for (int i = 0; i < SLAB_CLASSES; ++i) {
+    vm->pages[i] = NULL;
+    vm->unswept[i] = NULL;
+    vm->free_slots[i] = NULL;
+  }
+  vm->slab_bytes = 0;
+  vm->spare_pages = NULL;
+  vm->spare_count = 0;
+  vm->env = NULL;
+  vm->allocated_bytes = 0;
+  vm->next_gc = MAX_HEAP_SIZE;    /* 1 MiB */
+  vm->region = malloc(REGION_SIZE);
+  if (vm->region == NULL)
+    error("init_vm: Couldn't allocate the region.");
+  vm->region_base = 0;
+  vm->region_top = 0;
+  vm->nursery = malloc(NURSERY_SIZE);
+  if (vm->nursery == NULL)
+    error("init_vm: Couldn't allocate the nursery.");
+  vm->nursery_top = 0;
+  vm->remembered = make_array(ARRAY_MINIMAL_CAP);
+  vm->promoted = make_array(ARRAY_MINIMAL_CAP);
+  vm->held_penv = NULL;
+  vm->gray = make_array(ARRAY_MINIMAL_CAP);
+  vm->gray_limit = GRAY_STACK_MAX;
+  vm->gray_overflow = false;
+  vm->marking = false;
+  vm->pause_target = 0;
+  vm->mark_budget = MARK_STEP_BUDGET;
+  vm->nursery_limit = NURSERY_SIZE;
+  vm->max_pause = 0;
+  vm->minor_gcs = 0;
+  vm->major_gcs = 0;
   vm->astack = init_astack();
   vm->rstack = init_rstack();
   vm->env = init_env(vm);
-  vm->allocated_bytes = 0;
-  vm->next_gc = MAX_HEAP_SIZE;    /* 1 MiB */
 
   if (ignite) {
-    apush(vm->astack, epsilon);
-    AVM_ret_frame_t *end_frame = malloc(sizeof(AVM_ret_frame_t));
-    end_frame->addr = src->instr_size;
-    end_frame->offset = 0;
-    end_frame->penv = make_array(ARRAY_MINIMAL_CAP);
-    rpush(vm->rstack, end_frame);
+    vm->acc = epsilon;
+    AVM_ret_frame_t end_frame = { .addr = vm->code->instr_size,
+                                  .live = 0,
+                                  .penv = NULL,
+                                  .offset = 0,
+                                  .region = 0 };
+    if (!rpush(vm->rstack, end_frame))
+      error("init_vm: Couldn't push the end frame.");
   }
 
   return vm;
@@ -37,17 +183,31 @@ void finalize_vm(AVM_VM *vm) {
     vm->objs = vm->objs->next;
     free_object(vm, hd);
   }
-  /* Free return-frames */
-  for (size_t i = 0; i < array_size(vm->rstack); ++i) {
-    free(array_elem_unsafe(vm->rstack, i));
-  }
-  drop_array(vm->rstack);
+  free_slabs(vm);
+  /* Free the static closures; the GC never sees them. */
+  for (int i = 0; i <= vm->code->instr_size; ++i)
+    if (vm->statics[i] != VAL_NONE)
+      free_static_clos(vm->statics[i]);
+  free(vm->statics);
+  /* The region and the nursery are never swept either. */
+  free(vm->region);
+  free(vm->nursery);
+  drop_array(vm->remembered);
+  drop_array(vm->promoted);
+  drop_array(vm->gray);
+  /* Free return-frames; their penvs are objects. */
+  drop_rstack(vm->rstack);
   /* Free environment */
   drop_array(vm->env->cache);
   /* `penv` has been freed. */
   free(vm->env);
   /* Free argument-stack */
   drop_array(vm->astack);
+  /* Free the optimized and the lowered code */
+  free(vm->code->instr);
+  free(vm->code);
+  free(vm->ops);
+  free(vm->frames);
   /* Free the VM */
   free(vm);
 }
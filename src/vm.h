@@ -5,16 +5,97 @@
 
 #define MAX_HEAP_SIZE  128 * 1024 * 1024
 #define MIN_HEAP_SIZE    4 * 1024 * 1024
+#define REGION_SIZE      1024 * 1024
+#define NURSERY_SIZE     1024 * 1024
+/* Old objects of up to `SLAB_MAX_BYTES` bytes, header included, are
+   allocated in slots of `SLAB_PAGE_SIZE`-byte pages, one size class
+   per 16 bytes from 32. */
+#define SLAB_PAGE_SIZE   (64 * 1024)
+#define SLAB_MAX_BYTES   256
+#define SLAB_CLASSES     15
+/* Entries of the gray stack of a major collection beyond which it
+   overflows, and the heap is rescanned instead. */
+#define GRAY_STACK_MAX   (1024 * 1024)
+/* While a major collection marks incrementally, the nursery bytes
+   allocated between two of its steps, and the most references a step
+   follows unless `mark_budget` says otherwise. */
+#define GC_STEP_BYTES    (32 * 1024)
+#define MARK_STEP_BUDGET (16 * 1024)
+
+/* A page of slots of `slot_bytes` bytes, aligned on its size. A major
+   collection marks a slot in `marks`, by the bit of its first 16
+   bytes. */
+typedef struct AVM_page {
+  struct AVM_page *next;  /* in the same class */
+  uint32_t slot_bytes;
+  uint64_t marks[SLAB_PAGE_SIZE / 16 / 64];
+} AVM_page_t;
 
 typedef struct AVM_VM {
-  AVM_code_t *code;
+  AVM_code_t *code;   /* the optimized copy of the source code */
+  AVM_op_t *ops;      /* `code` lowered by `lower_code` */
+  _Bool verified;     /* `code` passed `verify_code` */
+  /* Space reserved on entering a frame at each address; by
+     `verify_code` when `verified`, only the closure and its argument
+     otherwise. The arities are counted in any case. */
+  AVM_frame_size_t *frames;
+  /* The closure pushed by `StaticClosure L`, or applied by `CallDirect
+     L`, at `statics[L]`, allocated once by `init_vm`; `VAL_NONE` at the
+     other addresses. */
+  AVM_value_t *statics;
   int pc;
+  /* Cache of the top of the argument stack: the logical stack is
+     `astack` followed by `acc`. `VAL_NONE` stands for the empty stack. */
+  AVM_value_t acc;
   AVM_astack_t *astack;
   AVM_rstack_t *rstack;
   AVM_env_t *env;
+  /* The old generation, swept by major collections. */
   AVM_object_t *objs;
   size_t allocated_bytes;
   size_t next_gc;
+  /* The slab pages of each size class, and their free slots, linked
+     by `next`. The pages a major collection has marked are `unswept`
+     until their class runs out of free slots. */
+  AVM_page_t *pages[SLAB_CLASSES];
+  AVM_page_t *unswept[SLAB_CLASSES];
+  AVM_object_t *free_slots[SLAB_CLASSES];
+  size_t slab_bytes;        /* of `allocated_bytes` */
+  /* Empty pages kept for any class (see `release_pages`). */
+  AVM_page_t *spare_pages;
+  size_t spare_count;
+  /* The young generation: objects are bumped in `NURSERY_SIZE` bytes,
+     and a minor collection copies the live ones to `objs` when it is
+     full. Objects too large for it are born old, and `remembered`
+     until then, since they may refer to young ones. */
+  char *nursery;
+  size_t nursery_top;
+  array_t *remembered;
+  array_t *promoted;        /* copied but not yet scanned */
+  AVM_penv_t *held_penv;    /* an argument of the allocation going on */
+  /* The objects a major collection has marked but not scanned yet,
+     up to `gray_limit`; if more are, `gray_overflow` is set. */
+  array_t *gray;
+  size_t gray_limit;
+  _Bool gray_overflow;
+  /* Incremental marking: with a nonzero `pause_target`, in
+     nanoseconds, a major collection only marks the roots when it
+     begins. Each allocation crossing `nursery_limit` then follows up
+     to `mark_budget` references from gray objects, for about
+     `pause_target`, until `marking` is done. */
+  _Bool marking;
+  uint64_t pause_target;
+  size_t mark_budget;
+  size_t nursery_limit;
+  uint64_t max_pause;       /* the longest collection, or step, in ns */
+  size_t minor_gcs;
+  size_t major_gcs;
+  /* The closures that never outlive their frame (see `verify_code`),
+     stacked by frame in `REGION_SIZE` bytes: the running frame's are
+     in `[region_base, region_top)`, and those of its callers below. */
+  char *region;
+  size_t region_base;
+  size_t region_top;
 } AVM_VM;
 
 extern AVM_value_t epsilon;
@@ -84,6 +84,38 @@ int main(void) {
       case AVM_Halt:
         printf("halt");
 	break;
+      case AVM_AddImm:
+        printf("addi %d", instr.const_int);
+        break;
+      case AVM_SubImm:
+        printf("subi %d", instr.const_int);
+        break;
+      case AVM_LeImm:
+        printf("lei  %d", instr.const_int);
+        break;
+      case AVM_EqImm:
+        printf("eqi  %d", instr.const_int);
+        break;
+      /* Only produced by the optimizer and `init_vm`; never parsed. */
+      case AVM_AccAccLeBf:
+      case AVM_AccSubImm:
+      case AVM_MarkAcc:
+      case AVM_AccApply:
+      case AVM_AccTailApply:
+      case AVM_BranchIfGt:
+      case AVM_BranchIfNe:
+      case AVM_BranchIfGtImm:
+      case AVM_BranchIfNeImm:
+      case AVM_FlatClosure:
+      case AVM_StaticClosure:
+      case AVM_ApplyN:
+      case AVM_TailApplyN:
+      case AVM_AccApplyN:
+      case AVM_AccTailApplyN:
+      case AVM_CallDirect:
+      case AVM_TailCallDirect:
+      case AVM_SelfTailCall:
+        break;
       }
       printf("\n");
     }
@@ -1,7 +1,10 @@
 #include <stdio.h>
+#include <string.h>
 #include "code.h"
 #include "interp.h"
 #include "runtime.h"
+#include "verify.h"
+#include "closure.h"
 
 
 static _Bool assert_int(AVM_value_t *v, int expected) {
@@ -268,6 +271,634 @@ static AVM_code_t make_le_program(int x, int y) {
   return CODE_OF(program);
 }
 
+// Over-application; `ret` passes the rest of the arguments on:
+// (fun x -> fun y -> x + y) x y, where the inner function is a closure
+static AVM_code_t make_overapply_program(int x, int y) {
+  static AVM_instr_t program[13];
+
+  // main:
+  program[0] = PUSHMARK();
+  program[1] = LDI(y);
+  program[2] = LDI(x);
+  program[3] = CLOSURE(6);
+  program[4] = APPLY();
+  program[5] = HALT();
+
+  // fun x -> (fun y -> x + y)
+  program[6] = CLOSURE(8);
+  program[7] = RETURN();
+
+  // fun y -> x + y
+  // env = [y, <8, [...]>, x, <6, [...]>]
+  program[8] = ACCESS(0);
+  program[9] = ACCESS(2);
+  program[10] = ADD();
+  program[11] = RETURN();
+  program[12] = HALT();
+
+  return CODE_OF(program);
+}
+
+// Superinstructions acc.acc.le.bf and acc.load.sub, with retargeting:
+// let x = a in let y = b in if x <= y then x - 1 else y - 1
+static AVM_code_t make_le_branch_program(int a, int b) {
+  static AVM_instr_t program[18];
+
+  program[0] = LDI(a);
+  program[1] = LET();
+  program[2] = LDI(b);
+  program[3] = LET();
+  // env = [y, x]
+  program[4] = ACCESS(1);
+  program[5] = ACCESS(0);
+  program[6] = LE();
+  program[7] = CJUMP(12);
+  program[8] = ACCESS(1);
+  program[9] = LDI(1);
+  program[10] = SUB();
+  program[11] = JUMP(15);
+  program[12] = ACCESS(0);
+  program[13] = LDI(1);
+  program[14] = SUB();
+  program[15] = ENDLET();
+  program[16] = ENDLET();
+  program[17] = HALT();
+
+  return CODE_OF(program);
+}
+
+// Superinstructions mark.acc and acc.app:
+// let v = v in let f = (fun x -> x - 1) in f v
+static AVM_code_t make_known_apply_program(int v) {
+  static AVM_instr_t program[15];
+
+  program[0] = LDI(v);
+  program[1] = LET();
+  program[2] = CLOSURE(11);
+  program[3] = LET();
+  // env = [f, v]
+  program[4] = PUSHMARK();
+  program[5] = ACCESS(1);
+  program[6] = ACCESS(0);
+  program[7] = APPLY();
+  program[8] = ENDLET();
+  program[9] = ENDLET();
+  program[10] = HALT();
+
+  // fun x -> x - 1
+  program[11] = ACCESS(0);
+  program[12] = LDI(1);
+  program[13] = SUB();
+  program[14] = RETURN();
+
+  return CODE_OF(program);
+}
+
+static AVM_code_t make_imm_program(int x) {
+  static AVM_instr_t program[5];
+
+  program[0] = LDI(x);
+  program[1] = ADDI(3);
+  program[2] = SUBI(1);
+  program[3] = LEI(10);
+  program[4] = HALT();
+
+  return CODE_OF(program);
+}
+
+// The constants are pushed as in compiled code; `optimize_code` turns
+// them into immediates, including the ones pushed below an `acc`.
+static AVM_code_t make_pred_program(int v) {
+  static AVM_instr_t program[13];
+
+  program[0] = LDI(v);
+  program[1] = LET();
+  program[2] = LDI(0);
+  program[3] = ACCESS(0);
+  program[4] = EQ();
+  program[5] = CJUMP(8);
+  program[6] = LDI(0);
+  program[7] = JUMP(11);
+  program[8] = LDI(-1);
+  program[9] = ACCESS(0);
+  program[10] = ADD();
+  program[11] = ENDLET();
+  program[12] = HALT();
+
+  return CODE_OF(program);
+}
+
+static AVM_code_t make_eq_branch_program(int x, int y) {
+  static AVM_instr_t program[14];
+
+  program[0] = LDI(x);
+  program[1] = LET();
+  program[2] = LDI(y);
+  program[3] = LET();
+  // env = [y, x]
+  program[4] = ACCESS(1);
+  program[5] = ACCESS(0);
+  program[6] = EQ();
+  program[7] = CJUMP(10);
+  program[8] = LDI(1);
+  program[9] = JUMP(11);
+  program[10] = LDI(0);
+  program[11] = ENDLET();
+  program[12] = ENDLET();
+  program[13] = HALT();
+
+  return CODE_OF(program);
+}
+
+static AVM_code_t make_sum_le_branch_program(int x, int y) {
+  static AVM_instr_t program[16];
+
+  program[0] = LDI(x);
+  program[1] = LET();
+  program[2] = LDI(y);
+  program[3] = LET();
+  // env = [y, x]
+  program[4] = ACCESS(0);
+  program[5] = ACCESS(1);
+  program[6] = ADD();
+  program[7] = ACCESS(0);
+  program[8] = LE();
+  program[9] = CJUMP(12);
+  program[10] = LDI(1);
+  program[11] = JUMP(13);
+  program[12] = LDI(0);
+  program[13] = ENDLET();
+  program[14] = ENDLET();
+  program[15] = HALT();
+
+  return CODE_OF(program);
+}
+
+static AVM_code_t make_underflow_program(int x) {
+  static AVM_instr_t program[3];
+
+  program[0] = LDI(x);
+  program[1] = ADD();
+  program[2] = HALT();
+
+  return CODE_OF(program);
+}
+
+static AVM_code_t make_unbound_program(int x) {
+  static AVM_instr_t program[4];
+
+  program[0] = LDI(x);
+  program[1] = LET();
+  program[2] = ACCESS(1);
+  program[3] = HALT();
+
+  return CODE_OF(program);
+}
+
+// let x = x in let y = y in (fun z -> x + z) 1 + x, where `endlet`
+// drops `y` from the frame frozen by `clos`
+static AVM_code_t make_captured_endlet_program(int x, int y) {
+  static AVM_instr_t program[17];
+
+  program[0] = LDI(x);
+  program[1] = LET();
+  program[2] = LDI(y);
+  program[3] = LET();
+  program[4] = PUSHMARK();
+  program[5] = LDI(1);
+  program[6] = CLOSURE(13); // captures [y, x]
+  program[7] = APPLY();
+  program[8] = ENDLET();
+  program[9] = ACCESS(0);
+  program[10] = ADD();
+  program[11] = ENDLET();
+  program[12] = HALT();
+  // Callee: env = [z, self, y, x]
+  program[13] = ACCESS(3);
+  program[14] = ACCESS(0);
+  program[15] = ADD();
+  program[16] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// let a = a in let b = b in let c = c in
+// (fun x -> (fun y -> b + y) x + c) 10, where the inner closure
+// captures `b` through the outer one
+static AVM_code_t make_nested_capture_program(int a, int b, int c) {
+  static AVM_instr_t program[25];
+
+  program[0] = LDI(a);
+  program[1] = LET();
+  program[2] = LDI(b);
+  program[3] = LET();
+  program[4] = LDI(c);
+  program[5] = LET();
+  program[6] = PUSHMARK();
+  program[7] = LDI(10);
+  program[8] = CLOSURE(14);
+  program[9] = APPLY();
+  program[10] = ENDLET();
+  program[11] = ENDLET();
+  program[12] = ENDLET();
+  program[13] = HALT();
+  // Outer: env = [x, self, c, b, a]
+  program[14] = PUSHMARK();
+  program[15] = ACCESS(0);
+  program[16] = CLOSURE(21);
+  program[17] = APPLY();
+  program[18] = ACCESS(2);
+  program[19] = ADD();
+  program[20] = RETURN();
+  // Inner: env = [y, self, x, outer, c, b, a]
+  program[21] = ACCESS(5);
+  program[22] = ACCESS(0);
+  program[23] = ADD();
+  program[24] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// let add3 a b c = a + b + c in let x = 100 in
+// let p = add3 1 in p 2 3 + p 10 20 + (let q = p 5 in q 7) + x, where
+// `p` and `q` are partial applications of the leading grabs
+static AVM_code_t make_pap_program(void) {
+  static AVM_instr_t program[42];
+
+  program[0] = LDI(100);
+  program[1] = LET();
+  program[2] = PUSHMARK();
+  program[3] = LDI(1);
+  program[4] = CLOSURE(34);
+  program[5] = APPLY();
+  program[6] = LET();
+  program[7] = PUSHMARK();
+  program[8] = LDI(3);
+  program[9] = LDI(2);
+  program[10] = ACCESS(0);
+  program[11] = APPLY();
+  program[12] = PUSHMARK();
+  program[13] = LDI(20);
+  program[14] = LDI(10);
+  program[15] = ACCESS(0);
+  program[16] = APPLY();
+  program[17] = ADD();
+  program[18] = PUSHMARK();
+  program[19] = LDI(5);
+  program[20] = ACCESS(0);
+  program[21] = APPLY();
+  program[22] = LET();
+  program[23] = PUSHMARK();
+  program[24] = LDI(7);
+  program[25] = ACCESS(0);
+  program[26] = APPLY();
+  program[27] = ADD();
+  program[28] = ENDLET();
+  program[29] = ACCESS(1);
+  program[30] = ADD();
+  program[31] = ENDLET();
+  program[32] = ENDLET();
+  program[33] = HALT();
+  // add3: env = [c, _, b, _, a, self]
+  program[34] = GRAB();
+  program[35] = GRAB();
+  program[36] = ACCESS(0);
+  program[37] = ACCESS(2);
+  program[38] = ADD();
+  program[39] = ACCESS(4);
+  program[40] = ADD();
+  program[41] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// (fun a -> let b = a in fun c -> b + c) 4 5, applied in two steps:
+// the grab follows a `let`, so the partial application is a closure
+static AVM_code_t make_late_grab_program(void) {
+  static AVM_instr_t program[18];
+
+  program[0] = PUSHMARK();
+  program[1] = LDI(4);
+  program[2] = CLOSURE(11);
+  program[3] = APPLY();
+  program[4] = LET();
+  program[5] = PUSHMARK();
+  program[6] = LDI(5);
+  program[7] = ACCESS(0);
+  program[8] = APPLY();
+  program[9] = ENDLET();
+  program[10] = HALT();
+  // env = [c, _, b, a, self]
+  program[11] = ACCESS(0);
+  program[12] = LET();
+  program[13] = GRAB();
+  program[14] = ACCESS(0);
+  program[15] = ACCESS(2);
+  program[16] = ADD();
+  program[17] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// (fun x -> x + 1) ((fun x -> x + 1) n), the closure built twice
+static AVM_code_t make_closed_twice_program(int n) {
+  static AVM_instr_t program[12];
+
+  program[0] = PUSHMARK();
+  program[1] = PUSHMARK();
+  program[2] = LDI(n);
+  program[3] = CLOSURE(8);
+  program[4] = APPLY();
+  program[5] = CLOSURE(8);
+  program[6] = APPLY();
+  program[7] = HALT();
+  // Callee: env = [x, self]
+  program[8] = ACCESS(0);
+  program[9] = LDI(1);
+  program[10] = ADD();
+  program[11] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// let sub_add a b c = a - b + c in
+// sub_add 10 3 5 + (let p = sub_add 10 3 in p 5), where both
+// applications bind their arguments at once, the second one short
+static AVM_code_t make_nary_program(void) {
+  static AVM_instr_t program[27];
+
+  program[0] = PUSHMARK();
+  program[1] = LDI(5);
+  program[2] = LDI(3);
+  program[3] = LDI(10);
+  program[4] = CLOSURE(19);
+  program[5] = APPLY();
+  program[6] = PUSHMARK();
+  program[7] = LDI(3);
+  program[8] = LDI(10);
+  program[9] = CLOSURE(19);
+  program[10] = APPLY();
+  program[11] = LET();
+  program[12] = PUSHMARK();
+  program[13] = LDI(5);
+  program[14] = ACCESS(0);
+  program[15] = APPLY();
+  program[16] = ENDLET();
+  program[17] = ADD();
+  program[18] = HALT();
+  // sub_add: env = [c, _, b, _, a, self]
+  program[19] = GRAB();
+  program[20] = GRAB();
+  program[21] = ACCESS(4);
+  program[22] = ACCESS(2);
+  program[23] = SUB();
+  program[24] = ACCESS(0);
+  program[25] = ADD();
+  program[26] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// f = x + 10 and g = x + 20; h is f or g depending on a branch.
+// h 1 + f 2 + g 3 = 11 + 12 + 23
+static AVM_code_t make_direct_program(void) {
+  static AVM_instr_t program[33];
+
+  program[0] = LDB(true);
+  program[1] = CJUMP(4);
+  program[2] = CLOSURE(25);
+  program[3] = JUMP(5);
+  program[4] = CLOSURE(29);
+  program[5] = LET();
+  program[6] = CLOSURE(25);
+  program[7] = LET();
+  program[8] = PUSHMARK();
+  program[9] = LDI(1);
+  program[10] = ACCESS(1);
+  program[11] = APPLY();
+  program[12] = PUSHMARK();
+  program[13] = LDI(2);
+  program[14] = ACCESS(0);
+  program[15] = APPLY();
+  program[16] = ADD();
+  program[17] = PUSHMARK();
+  program[18] = LDI(3);
+  program[19] = CLOSURE(29);
+  program[20] = APPLY();
+  program[21] = ADD();
+  program[22] = ENDLET();
+  program[23] = ENDLET();
+  program[24] = HALT();
+  // f
+  program[25] = ACCESS(0);
+  program[26] = LDI(10);
+  program[27] = ADD();
+  program[28] = RETURN();
+  // g
+  program[29] = ACCESS(0);
+  program[30] = LDI(20);
+  program[31] = ADD();
+  program[32] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// loop acc n = if n = 0 then acc else loop (acc + n) (n - 1)
+// loop 0 1000 = 500500
+static AVM_code_t make_self_tail_program(void) {
+  static AVM_instr_t program[21];
+
+  program[0] = PUSHMARK();
+  program[1] = LDI(1000);
+  program[2] = LDI(0);
+  program[3] = CLOSURE(6);
+  program[4] = APPLY();
+  program[5] = HALT();
+  // loop: env = [n, _, acc, self]
+  program[6] = GRAB();
+  program[7] = ACCESS(0);
+  program[8] = LDI(0);
+  program[9] = EQ();
+  program[10] = CJUMP(13);
+  program[11] = ACCESS(2);
+  program[12] = RETURN();
+  program[13] = ACCESS(0);
+  program[14] = LDI(1);
+  program[15] = SUB();
+  program[16] = ACCESS(2);
+  program[17] = ACCESS(0);
+  program[18] = ADD();
+  program[19] = ACCESS(3);
+  program[20] = TAILAPPLY();
+
+  return CODE_OF(program);
+}
+
+static AVM_code_t make_region_program(void) {
+  static AVM_instr_t program[39];
+
+  program[0] = PUSHMARK();
+  program[1] = LDI(0);
+  program[2] = LDI(1000);
+  program[3] = CLOSURE(6);
+  program[4] = APPLY();
+  program[5] = HALT();
+  // loop: env = [s, _, n, self]
+  program[6] = GRAB();
+  program[7] = ACCESS(2);
+  program[8] = LDI(0);
+  program[9] = EQ();
+  program[10] = CJUMP(13);
+  program[11] = ACCESS(0);
+  program[12] = RETURN();
+  // let k = n in let f = fun x -> x + k in loop (n - 1) (s + f 2 - f 1)
+  program[13] = ACCESS(2);
+  program[14] = LET();
+  program[15] = CLOSURE(35);
+  program[16] = LET();
+  program[17] = PUSHMARK();
+  program[18] = LDI(2);
+  program[19] = ACCESS(0);
+  program[20] = APPLY();
+  program[21] = PUSHMARK();
+  program[22] = LDI(1);
+  program[23] = ACCESS(0);
+  program[24] = APPLY();
+  program[25] = SUB();
+  program[26] = ACCESS(2);
+  program[27] = ADD();
+  program[28] = ACCESS(4);
+  program[29] = LDI(1);
+  program[30] = SUB();
+  program[31] = ENDLET();
+  program[32] = ENDLET();
+  program[33] = ACCESS(3);
+  program[34] = TAILAPPLY();
+  // f: env = [x, self, k, ...]
+  program[35] = ACCESS(0);
+  program[36] = ACCESS(2);
+  program[37] = ADD();
+  program[38] = RETURN();
+
+  return CODE_OF(program);
+}
+
+static AVM_code_t make_escape_program(void) {
+  static AVM_instr_t program[14];
+
+  // (fun k -> fun x -> x + k) 3 4
+  program[0] = PUSHMARK();
+  program[1] = LDI(4);
+  program[2] = PUSHMARK();
+  program[3] = LDI(3);
+  program[4] = CLOSURE(8);
+  program[5] = APPLY();
+  program[6] = APPLY();
+  program[7] = HALT();
+  program[8] = CLOSURE(10);
+  program[9] = RETURN();
+  program[10] = ACCESS(0);
+  program[11] = ACCESS(2);
+  program[12] = ADD();
+  program[13] = RETURN();
+
+  return CODE_OF(program);
+}
+
+// let x = 7 in let i = n in, while i > 0, let c = (fun _ -> previous c,
+// or x) in let i = i - 1; then let k = (a closure of the whole frame)
+// in loop 100000 (allocating garbage); walk n (k 0), where walk applies
+// its function to 0 n times, back to x. The frame captured by `k` is
+// too large for the nursery, so it is born old, referring to young
+// closures. The environment grows in a loop, so this is not verified.
+static AVM_code_t make_large_frame_program(int n) {
+  static AVM_instr_t program[67];
+
+  program[0] = LDI(7);
+  program[1] = LET();
+  program[2] = LDI(n);
+  program[3] = LET();
+  program[4] = CLOSURE(30);
+  program[5] = LET();
+  program[6] = ACCESS(1);
+  program[7] = LDI(1);
+  program[8] = SUB();
+  program[9] = LET();
+  program[10] = ACCESS(0);
+  program[11] = LDI(0);
+  program[12] = EQ();
+  program[13] = CJUMP(4);
+  program[14] = CLOSURE(32);
+  program[15] = LET();
+  program[16] = PUSHMARK();
+  program[17] = LDI(100000);
+  program[18] = CLOSURE(53);
+  program[19] = APPLY();
+  program[20] = LET();
+  program[21] = PUSHMARK();
+  program[22] = PUSHMARK();
+  program[23] = LDI(0);
+  program[24] = ACCESS(1);
+  program[25] = APPLY();
+  program[26] = LDI(n);
+  program[27] = CLOSURE(37);
+  program[28] = APPLY();
+  program[29] = HALT();
+  // c: env = [_, self, i, previous c]
+  program[30] = ACCESS(3);
+  program[31] = RETURN();
+  // k: drops a captured binding, so it captures the whole environment
+  program[32] = ENDLET();
+  program[33] = ENDLET();
+  program[34] = ENDLET();
+  program[35] = ACCESS(0);
+  program[36] = RETURN();
+  // walk: env = [f, _, n, self]
+  program[37] = GRAB();
+  program[38] = ACCESS(2);
+  program[39] = LDI(0);
+  program[40] = EQ();
+  program[41] = CJUMP(44);
+  program[42] = ACCESS(0);
+  program[43] = RETURN();
+  program[44] = PUSHMARK();
+  program[45] = LDI(0);
+  program[46] = ACCESS(0);
+  program[47] = APPLY();
+  program[48] = ACCESS(2);
+  program[49] = LDI(1);
+  program[50] = SUB();
+  program[51] = ACCESS(3);
+  program[52] = TAILAPPLY();
+  // loop: env = [n, self]
+  program[53] = ACCESS(0);
+  program[54] = LDI(0);
+  program[55] = EQ();
+  program[56] = CJUMP(59);
+  program[57] = LDI(0);
+  program[58] = RETURN();
+  program[59] = CLOSURE(32);
+  program[60] = LET();
+  program[61] = ENDLET();
+  program[62] = ACCESS(0);
+  program[63] = LDI(1);
+  program[64] = SUB();
+  program[65] = ACCESS(1);
+  program[66] = TAILAPPLY();
+
+  return CODE_OF(program);
+}
+
+static int count_regions(AVM_code_t *code) {
+  AVM_VM *vm = init_vm(code, false);
+  int regions = 0;
+  for (int i = 0; i < vm->code->instr_size; ++i)
+    if (vm->ops[i].flags & AVM_OP_REGION)
+      ++regions;
+  finalize_vm(vm);
+  return regions;
+}
+
 int main(void) {
   // Test 1: 2 + 3 => 5
   AVM_code_t add_code = make_add_program(2, 3);
@@ -365,5 +996,364 @@ int main(void) {
   if (assert_bool(le_false_result, false))
     printf("Test 15 passed.\n");
 
+  // Test 17: (fun x -> fun y -> x + y) 20 3 = 23, returning a closure
+  AVM_code_t overapply_code = make_overapply_program(20, 3);
+  AVM_value_t *overapply_result = _run_code_with_result(&overapply_code);
+  if (assert_int(overapply_result, 23))
+    printf("Test 17 passed.\n");
+
+  // Test 18: let x = 3 in let y = 7 in if x <= y then x - 1 else y - 1 = 2
+  AVM_code_t le_branch_then_code = make_le_branch_program(3, 7);
+  AVM_value_t *le_branch_then_result = _run_code_with_result(&le_branch_then_code);
+  if (assert_int(le_branch_then_result, 2))
+    printf("Test 18 passed.\n");
+
+  // Test 19: let x = 9 in let y = 4 in if x <= y then x - 1 else y - 1 = 3
+  AVM_code_t le_branch_else_code = make_le_branch_program(9, 4);
+  AVM_value_t *le_branch_else_result = _run_code_with_result(&le_branch_else_code);
+  if (assert_int(le_branch_else_result, 3))
+    printf("Test 19 passed.\n");
+
+  // Test 20: let v = 42 in let f = (fun x -> x - 1) in f v = 41
+  AVM_code_t known_apply_code = make_known_apply_program(42);
+  AVM_value_t *known_apply_result = _run_code_with_result(&known_apply_code);
+  if (assert_int(known_apply_result, 41))
+    printf("Test 20 passed.\n");
+
+  // Test 21: 8 + 3 - 1 <= 10 = true, with immediate operands
+  AVM_code_t imm_code = make_imm_program(8);
+  AVM_value_t *imm_result = _run_code_with_result(&imm_code);
+  if (assert_bool(imm_result, true))
+    printf("Test 21 passed.\n");
+
+  // Test 22: let v = 5 in if 0 = v then 0 else -1 + v = 4
+  AVM_code_t pred_code = make_pred_program(5);
+  AVM_value_t *pred_result = _run_code_with_result(&pred_code);
+  if (assert_int(pred_result, 4))
+    printf("Test 22 passed.\n");
+
+  // Test 23: let v = 0 in if 0 = v then 0 else -1 + v = 0
+  AVM_code_t pred_zero_code = make_pred_program(0);
+  AVM_value_t *pred_zero_result = _run_code_with_result(&pred_zero_code);
+  if (assert_int(pred_zero_result, 0))
+    printf("Test 23 passed.\n");
+
+  // Test 24: let x = 3 in let y = 3 in if x = y then 1 else 0 = 1
+  AVM_code_t eq_branch_then_code = make_eq_branch_program(3, 3);
+  AVM_value_t *eq_branch_then_result = _run_code_with_result(&eq_branch_then_code);
+  if (assert_int(eq_branch_then_result, 1))
+    printf("Test 24 passed.\n");
+
+  // Test 25: let x = 3 in let y = 4 in if x = y then 1 else 0 = 0
+  AVM_code_t eq_branch_else_code = make_eq_branch_program(3, 4);
+  AVM_value_t *eq_branch_else_result = _run_code_with_result(&eq_branch_else_code);
+  if (assert_int(eq_branch_else_result, 0))
+    printf("Test 25 passed.\n");
+
+  // Test 26: let x = 5 in let y = 2 in if x + y <= y then 1 else 0 = 0
+  AVM_code_t sum_le_branch_code = make_sum_le_branch_program(5, 2);
+  AVM_value_t *sum_le_branch_result = _run_code_with_result(&sum_le_branch_code);
+  if (assert_int(sum_le_branch_result, 0))
+    printf("Test 26 passed.\n");
+
+  // Test 27: the verifier proves every check of Test 26 redundant
+  _Bool unchecked[17] = { false };
+  if (verify_code(&sum_le_branch_code, false,
+                  &(AVM_verify_result_t){ .unchecked = unchecked })
+      && unchecked[4] && unchecked[6] && unchecked[8] && unchecked[9])
+    printf("Test 27 passed.\n");
+
+  // Test 28: the verifier rejects `add` on a single value
+  AVM_code_t underflow_code = make_underflow_program(1);
+  if (!verify_code(&underflow_code, false, NULL)
+      && last_verify_error()->pc == 1)
+    printf("Test 28 passed.\n");
+
+  // Test 29: the verifier rejects `acc 1` under a single `let`
+  AVM_code_t unbound_code = make_unbound_program(1);
+  if (!verify_code(&unbound_code, false, NULL)
+      && last_verify_error()->pc == 2)
+    printf("Test 29 passed.\n");
+
+  // Test 30: the frame of Test 26 needs two stack slots and two bindings
+  AVM_frame_size_t frames[17];
+  if (verify_code(&sum_le_branch_code, false,
+                  &(AVM_verify_result_t){ .frames = frames })
+      && frames[0].stack == 2 && frames[0].env == 2)
+    printf("Test 30 passed.\n");
+
+  // Test 31: let x = 5 in let y = 7 in (fun z -> x + z) 1 + x = 11
+  AVM_code_t captured_endlet_code = make_captured_endlet_program(5, 7);
+  AVM_value_t *captured_endlet_result = _run_code_with_result(&captured_endlet_code);
+  if (assert_int(captured_endlet_result, 11))
+    printf("Test 31 passed.\n");
+
+  // Test 32: the closure of Test 31 captures `x` only, renumbered to 2
+  AVM_code_t *flat_code = flatten_closures(&captured_endlet_code);
+  if (flat_code->instr_size == 18
+      && flat_code->instr[6].kind == AVM_Access && flat_code->instr[6].access == 1
+      && flat_code->instr[7].kind == AVM_FlatClosure
+      && flat_code->instr[7].addr == 14 && flat_code->instr[7].const_int == 1
+      && flat_code->instr[14].kind == AVM_Access && flat_code->instr[14].access == 2)
+    printf("Test 32 passed.\n");
+  free(flat_code->instr);
+  free(flat_code);
+
+  // Test 33: let a = 3 in let b = 4 in let c = 5 in
+  //          (fun x -> (fun y -> b + y) x + c) 10 = 19
+  AVM_code_t nested_capture_code = make_nested_capture_program(3, 4, 5);
+  AVM_value_t *nested_capture_result = _run_code_with_result(&nested_capture_code);
+  if (assert_int(nested_capture_result, 19))
+    printf("Test 33 passed.\n");
+
+  // Test 34: a closure capturing nothing is static, built once
+  AVM_code_t closed_twice_code = make_closed_twice_program(40);
+  AVM_code_t *static_code = flatten_closures(&closed_twice_code);
+  AVM_value_t *closed_twice_result = _run_code_with_result(&closed_twice_code);
+  if (static_code->instr_size == 12
+      && static_code->instr[3].kind == AVM_StaticClosure
+      && static_code->instr[5].kind == AVM_StaticClosure
+      && static_code->instr[5].addr == 8
+      && assert_int(closed_twice_result, 42))
+    printf("Test 34 passed.\n");
+  free(static_code->instr);
+  free(static_code);
+
+  // Test 35: dropping a captured binding shares the frame, allocating nothing
+  AVM_VM *env_vm = init_vm(&add_code, false);
+  extend(env_vm->env, mk_int(1));
+  extend(env_vm->env, mk_int(2));
+  extend(env_vm->env, mk_int(3));
+  perpetuate(env_vm, env_vm->env);
+  AVM_penv_t *frozen = env_vm->env->penv;
+  AVM_object_t *objs = env_vm->objs;
+  remove_head(env_vm->env);
+  remove_head(env_vm->env);
+  if (env_vm->objs == objs && env_vm->env->penv == frozen
+      && frozen->size == 3
+      && lookup(env_vm->env, 0) == mk_int(1))
+    printf("Test 35 passed.\n");
+  finalize_vm(env_vm);
+
+  // Test 36: partial applications of add3 = 6 + 31 + 13 + 100 = 150
+  AVM_code_t pap_code = make_pap_program();
+  AVM_value_t *pap_result = _run_code_with_result(&pap_code);
+  if (assert_int(pap_result, 150))
+    printf("Test 36 passed.\n");
+
+  // Test 37: a partial application after a `let` = 4 + 5
+  AVM_code_t late_grab_code = make_late_grab_program();
+  AVM_value_t *late_grab_result = _run_code_with_result(&late_grab_code);
+  if (assert_int(late_grab_result, 9))
+    printf("Test 37 passed.\n");
+
+  // Test 38: n-ary applications = 12 + 12
+  AVM_code_t nary_code = make_nary_program();
+  AVM_VM *nary_vm = init_vm(&nary_code, false);
+  int nary[2], nary_count = 0;
+  for (int i = 0; i < nary_vm->code->instr_size; ++i)
+    if ((nary_vm->code->instr[i].kind == AVM_ApplyN ||
+         nary_vm->code->instr[i].kind == AVM_CallDirect) && nary_count < 2)
+      nary[nary_count++] = nary_vm->code->instr[i].const_int;
+  _Bool nary_verified = nary_vm->verified;
+  finalize_vm(nary_vm);
+  AVM_value_t *nary_result = _run_code_with_result(&nary_code);
+  if (nary_verified && nary_count == 2 && nary[0] == 3 && nary[1] == 2
+      && assert_int(nary_result, 24))
+    printf("Test 38 passed.\n");
+
+  // Test 39: known closures are called directly, the others are not
+  AVM_code_t direct_code = make_direct_program();
+  AVM_VM *direct_vm = init_vm(&direct_code, false);
+  int direct = 0, indirect = 0;
+  for (int i = 0; i < direct_vm->code->instr_size; ++i) {
+    if (direct_vm->code->instr[i].kind == AVM_CallDirect)
+      ++direct;
+    else if (direct_vm->code->instr[i].kind == AVM_AccApply)
+      ++indirect;
+  }
+  _Bool direct_verified = direct_vm->verified;
+  finalize_vm(direct_vm);
+  AVM_value_t *direct_result = _run_code_with_result(&direct_code);
+  if (direct_verified && direct == 2 && indirect == 1
+      && assert_int(direct_result, 46))
+    printf("Test 39 passed.\n");
+
+  // Test 40: a self tail call rebinds the arguments in place
+  AVM_code_t self_tail_code = make_self_tail_program();
+  AVM_VM *self_tail_vm = init_vm(&self_tail_code, false);
+  int self_tails = 0;
+  for (int i = 0; i < self_tail_vm->code->instr_size; ++i)
+    if (self_tail_vm->code->instr[i].kind == AVM_SelfTailCall)
+      ++self_tails;
+  finalize_vm(self_tail_vm);
+  AVM_value_t *self_tail_result = _run_code_with_result(&self_tail_code);
+  if (self_tails == 1 && assert_int(self_tail_result, 500500))
+    printf("Test 40 passed.\n");
+
+  // Test 41: a closure only applied in its frame is made in the region,
+  // one returned is not
+  AVM_code_t region_code = make_region_program();
+  AVM_code_t escape_code = make_escape_program();
+  int regions = count_regions(&region_code), escaping = count_regions(&escape_code);
+  AVM_value_t *region_result = _run_code_with_result(&region_code);
+  AVM_value_t *escape_result = _run_code_with_result(&escape_code);
+  if (regions == 1 && escaping == 0 && assert_int(region_result, 1000)
+      && assert_int(escape_result, 7))
+    printf("Test 41 passed.\n");
+
+  // Test 42: young closures survive minor collections, including those
+  // only an old frame refers to
+  AVM_code_t large_code = make_large_frame_program(10000);
+  AVM_VM *large_vm = init_vm(&large_code, false);
+  AVM_value_t large_result = run(large_vm);
+  if (large_vm->minor_gcs > 0 && assert_int(&large_result, 7))
+    printf("Test 42 passed.\n");
+  finalize_vm(large_vm);
+
+  // Test 43: a slot freed by a major collection is reused, and a page
+  // left empty is released
+  AVM_VM *slab_vm = init_vm(&add_code, false);
+  slab_vm->acc = new_clos(slab_vm, 0, NULL, 0);
+  extend(slab_vm->env, new_clos(slab_vm, 0, NULL, 0));
+  run_gc(slab_vm);
+  AVM_object_t *freed = as_obj(lookup(slab_vm->env, 0));
+  remove_head(slab_vm->env);
+  run_gc(slab_vm);
+  extend(slab_vm->env, new_clos(slab_vm, 0, NULL, 0));
+  run_gc(slab_vm);
+  _Bool reused = as_obj(lookup(slab_vm->env, 0)) == freed;
+  slab_vm->acc = VAL_NONE;
+  remove_head(slab_vm->env);
+  run_gc(slab_vm);
+  if (reused && slab_vm->pages[0] == NULL && slab_vm->spare_count == 1)
+    printf("Test 43 passed.\n");
+  finalize_vm(slab_vm);
+
+  // Test 44: a million-deep chain of closures is marked without
+  // recursion, and collected
+  AVM_VM *chain_vm = init_vm(&add_code, false);
+  run_gc(chain_vm);
+  size_t chain_base = chain_vm->allocated_bytes;
+  chain_vm->acc = new_clos(chain_vm, 0, NULL, 0);
+  for (int i = 0; i < 1000000; ++i)
+    chain_vm->acc = new_flat_clos(chain_vm, 0, &chain_vm->acc, 1);
+  run_gc(chain_vm);
+  int chain_length = 0;
+  for (AVM_clos_t *clos = (AVM_clos_t*)(as_obj(chain_vm->acc) + 1); clos->penv != NULL;
+       clos = (AVM_clos_t*)(as_obj(clos->penv->values[0]) + 1))
+    ++chain_length;
+  chain_vm->acc = VAL_NONE;
+  run_gc(chain_vm);
+  if (chain_length == 1000000 && chain_vm->allocated_bytes == chain_base)
+    printf("Test 44 passed.\n");
+  finalize_vm(chain_vm);
+
+  // Test 45: objects the gray stack overflows with are rescanned
+  AVM_VM *gray_vm = init_vm(&add_code, false);
+  for (int i = 0; i < 100; ++i) {
+    gray_vm->acc = new_clos(gray_vm, 0, NULL, 0);
+    gray_vm->acc = new_flat_clos(gray_vm, 0, &gray_vm->acc, 1);
+    extend(gray_vm->env, gray_vm->acc);
+  }
+  gray_vm->acc = VAL_NONE;
+  perpetuate(gray_vm, gray_vm->env);
+  run_gc(gray_vm);
+  size_t gray_live = gray_vm->allocated_bytes;
+  gray_vm->gray_limit = 2;
+  run_gc(gray_vm);
+  if (gray_vm->allocated_bytes == gray_live && !gray_vm->gray_overflow)
+    printf("Test 45 passed.\n");
+  finalize_vm(gray_vm);
+
+  // Test 46: a major collection leaves the pages with survivors to be
+  // swept when their class needs slots, and accounts only for those
+  AVM_VM *lazy_vm = init_vm(&add_code, false);
+  run_gc(lazy_vm);
+  size_t lazy_base = lazy_vm->allocated_bytes;
+  for (int i = 0; i < 100; ++i)
+    extend(lazy_vm->env, new_clos(lazy_vm, 0, NULL, 0));
+  run_gc(lazy_vm);
+  size_t lazy_slot = (lazy_vm->allocated_bytes - lazy_base) / 100;
+  for (int i = 0; i < 99; ++i)
+    remove_head(lazy_vm->env);
+  run_gc(lazy_vm);
+  _Bool lazy = lazy_vm->unswept[0] != NULL && lazy_vm->pages[0] == NULL
+    && lazy_vm->free_slots[0] == NULL
+    && lazy_vm->allocated_bytes == lazy_base + lazy_slot;
+  extend(lazy_vm->env, new_clos(lazy_vm, 0, NULL, 0));
+  run_gc(lazy_vm);
+  if (lazy && lazy_vm->allocated_bytes == lazy_base + 2 * lazy_slot
+      && as_obj(lookup(lazy_vm->env, 0)) != as_obj(lookup(lazy_vm->env, 1)))
+    printf("Test 46 passed.\n");
+  finalize_vm(lazy_vm);
+
+  // Test 47: marking interleaved with allocation, a few references at
+  // a time, keeps what is reachable and reclaims the rest
+  AVM_VM *inc_vm = init_vm(&add_code, false);
+  run_gc(inc_vm);
+  size_t inc_base = inc_vm->allocated_bytes, inc_majors = inc_vm->major_gcs;
+  inc_vm->pause_target = UINT64_MAX;
+  inc_vm->mark_budget = 1024;
+  inc_vm->acc = new_clos(inc_vm, 0, NULL, 0);
+  for (int i = 0; i < 200000; ++i) {
+    new_clos(inc_vm, 0, NULL, 0);
+    inc_vm->acc = new_flat_clos(inc_vm, 0, &inc_vm->acc, 1);
+  }
+  inc_majors = inc_vm->major_gcs - inc_majors;
+  run_gc(inc_vm);
+  int inc_length = 0;
+  for (AVM_clos_t *clos = (AVM_clos_t*)(as_obj(inc_vm->acc) + 1); clos->penv != NULL;
+       clos = (AVM_clos_t*)(as_obj(clos->penv->values[0]) + 1))
+    ++inc_length;
+  inc_vm->acc = VAL_NONE;
+  run_gc(inc_vm);
+  if (inc_majors > 0 && inc_length == 200000 && inc_vm->max_pause > 0
+      && inc_vm->allocated_bytes == inc_base)
+    printf("Test 47 passed.\n");
+  finalize_vm(inc_vm);
+
+  // Test 48: a page a class takes while marking is under way has its
+  // slots free once marking is done, even a spare page left with marks
+  AVM_VM *fresh_vm = init_vm(&add_code, false);
+  for (int i = 0; i < 3000; ++i)
+    extend(fresh_vm->env, new_clos(fresh_vm, 0, NULL, 0));
+  run_gc(fresh_vm);
+  for (int i = 0; i < 3000; ++i)
+    remove_head(fresh_vm->env);
+  AVM_value_t fresh_values[20];
+  for (int i = 0; i < 20; ++i)
+    fresh_values[i] = mk_int(i);
+  for (int i = 0; i < 1000; ++i)
+    extend(fresh_vm->env, new_flat_clos(fresh_vm, 0, fresh_values, 1));
+  run_gc(fresh_vm);
+  _Bool fresh_spares = fresh_vm->spare_pages != NULL;
+  for (AVM_page_t *page = fresh_vm->spare_pages; page != NULL; page = page->next)
+    memset(page->marks, 0xff, sizeof(page->marks));
+  fresh_vm->pause_target = UINT64_MAX;
+  fresh_vm->mark_budget = 0;
+  fresh_vm->next_gc = fresh_vm->allocated_bytes - 1;
+  while (!fresh_vm->marking)
+    new_clos(fresh_vm, 0, NULL, 0);
+  fresh_vm->acc = new_flat_clos(fresh_vm, 0, fresh_values, 20);
+  size_t fresh_minors = fresh_vm->minor_gcs;
+  while (fresh_vm->minor_gcs == fresh_minors)
+    new_clos(fresh_vm, 0, NULL, 0);
+  _Bool fresh_marking = fresh_vm->marking;
+  fresh_vm->mark_budget = MARK_STEP_BUDGET;
+  while (fresh_vm->marking)
+    new_clos(fresh_vm, 0, NULL, 0);
+  AVM_page_t *fresh_page = (AVM_page_t*)((uintptr_t)((AVM_object_t*)
+    ((AVM_clos_t*)(as_obj(fresh_vm->acc) + 1))->penv - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+  int fresh_marks = 0;
+  for (size_t i = 0; i < sizeof(fresh_page->marks) / sizeof(fresh_page->marks[0]); ++i)
+    fresh_marks += __builtin_popcountll(fresh_page->marks[i]);
+  size_t fresh_slab = fresh_vm->slab_bytes;
+  run_gc(fresh_vm);
+  if (fresh_spares && fresh_marking && fresh_marks == 1
+      && fresh_slab == fresh_vm->slab_bytes)
+    printf("Test 48 passed.\n");
+  finalize_vm(fresh_vm);
+
   return 0;
 }